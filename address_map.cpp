@@ -31,9 +31,113 @@
 #include "controller_config.h"
 #include "device_config.h"
 
+// x86 builds get a BMI2 and an AVX2 decoder, selected at run time
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MEMBLES_X86_DECODER
+#include <immintrin.h>
+#endif
+
 namespace membles
 {
 
+/*
+ * Extract a field of an address using its mask/shift pairs
+ */
+static inline uint32_t extract(uint64_t addr, const BitField &field)
+{
+    uint64_t ret = 0;
+    for (auto &run : field.runs) {
+        ret |= ((addr >> run.addr_pos) & run.mask) << run.field_pos;
+    }
+    return ret;
+}
+
+
+#ifdef MEMBLES_X86_DECODER
+/*
+ * Extract all fields of an address using PEXT
+ */
+__attribute__((target("bmi2")))
+static void extract_pext(uint64_t addr, const BitField &chan_field,
+                         const BitField &rank_field,
+                         const BitField &bank_field,
+                         const BitField &row_field, const BitField &col_field,
+                         uint32_t &chan, uint32_t &rank, uint32_t &bank,
+                         uint32_t &row, uint32_t &col)
+{
+    chan = _pext_u64(addr, chan_field.pext_mask);
+    rank = _pext_u64(addr, rank_field.pext_mask);
+    bank = _pext_u64(addr, bank_field.pext_mask);
+    row = _pext_u64(addr, row_field.pext_mask);
+    col = _pext_u64(addr, col_field.pext_mask);
+}
+
+
+/*
+ * Extract a field of 4 addresses at a time using AVX2
+ * The remainder is handled by the scalar path
+ */
+__attribute__((target("avx2")))
+static void extract_avx2(const uint64_t *addrs, size_t n,
+                         const BitField &field, uint32_t *out)
+{
+    // collect the low 32 bits of each 64-bit lane into the lower half
+    const __m256i pack = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i addr = _mm256_loadu_si256((const __m256i *)(addrs + i));
+        __m256i ret = _mm256_setzero_si256();
+        for (auto &run : field.runs) {
+            __m256i val = _mm256_srl_epi64(addr,
+                                           _mm_cvtsi32_si128(run.addr_pos));
+            val = _mm256_and_si256(val, _mm256_set1_epi64x(run.mask));
+            val = _mm256_sll_epi64(val, _mm_cvtsi32_si128(run.field_pos));
+            ret = _mm256_or_si256(ret, val);
+        }
+        ret = _mm256_permutevar8x32_epi32(ret, pack);
+        _mm_storeu_si128((__m128i *)(out + i), _mm256_castsi256_si128(ret));
+    }
+    for (; i < n; ++i) {
+        out[i] = extract(addrs[i], field);
+    }
+}
+#endif
+
+
+/*
+ * Compile a list of bit positions into mask/shift pairs
+ * bits[i] is the address bit that goes to bit i of the field
+ */
+static BitField compile_field(const vector<uint32_t> &bits)
+{
+    BitField field;
+    size_t i = 0;
+    while (i < bits.size()) {
+        // detect a run of contiguous address bits
+        size_t len = 1;
+        while (i + len < bits.size() && bits[i + len] == bits[i] + len) len++;
+        BitRun run;
+        run.addr_pos = bits[i];
+        run.field_pos = i;
+        run.mask = (1UL << len) - 1;
+        field.runs.push_back(run);
+        field.pext_mask |= run.mask << run.addr_pos;
+        if (i && bits[i] < bits[i - 1]) field.ascending = false;
+        i += len;
+    }
+    return field;
+}
+
+
+/* ctor: AddressMap
+ * Decoders are selected at init time
+ */
+AddressMap::AddressMap()
+    : use_pext(false),
+      use_avx2(false)
+{}
+
+
 bool AddressMap::init(CtrlCfg *ctrl_cfg, DevCfg *dev_cfg)
 {
     uint32_t log_num_chan = log2(ctrl_cfg->num_chan);
@@ -161,6 +265,8 @@ bool AddressMap::init(CtrlCfg *ctrl_cfg, DevCfg *dev_cfg)
         return false;
     }
 
+    compile();
+
     return true;
 }
 
@@ -169,13 +275,45 @@ bool AddressMap::init(CtrlCfg *ctrl_cfg, DevCfg *dev_cfg)
  * Decode a physical address into memory address segments
  */
 void AddressMap::map(uint64_t addr, uint32_t &chan, uint32_t &rank,
-                     uint32_t &bank, uint32_t &row, uint32_t &col)
+                     uint32_t &bank, uint32_t &row, uint32_t &col) const
 {
-    chan = extract(addr, chan_bits);
-    rank = extract(addr, rank_bits);
-    bank = extract(addr, bank_bits);
-    row = extract(addr, row_bits);
-    col = extract(addr, col_bits);
+#ifdef MEMBLES_X86_DECODER
+    if (use_pext) {
+        extract_pext(addr, chan_field, rank_field, bank_field, row_field,
+                     col_field, chan, rank, bank, row, col);
+        return;
+    }
+#endif
+    chan = extract(addr, chan_field);
+    rank = extract(addr, rank_field);
+    bank = extract(addr, bank_field);
+    row = extract(addr, row_field);
+    col = extract(addr, col_field);
+}
+
+
+/*
+ * Decode an array of physical addresses
+ * Meant for trace preprocessing and analysis, where millions of addresses
+ *   are decoded in one go
+ */
+void AddressMap::map(const uint64_t *addrs, size_t n, uint32_t *chan,
+                     uint32_t *rank, uint32_t *bank, uint32_t *row,
+                     uint32_t *col) const
+{
+#ifdef MEMBLES_X86_DECODER
+    if (use_avx2) {
+        extract_avx2(addrs, n, chan_field, chan);
+        extract_avx2(addrs, n, rank_field, rank);
+        extract_avx2(addrs, n, bank_field, bank);
+        extract_avx2(addrs, n, row_field, row);
+        extract_avx2(addrs, n, col_field, col);
+        return;
+    }
+#endif
+    for (size_t i = 0; i < n; ++i) {
+        map(addrs[i], chan[i], rank[i], bank[i], row[i], col[i]);
+    }
 }
 
 
@@ -225,15 +363,23 @@ void AddressMap::increment(uint32_t &pos)
 
 
 /*
- * Extract parts of address
+ * Compile the bit lists into mask/shift pairs and pick the decoders
  */
-uint32_t AddressMap::extract(uint64_t addr, const vector<uint32_t> &bits)
+void AddressMap::compile()
 {
-    uint32_t ret = 0;
-    for (auto iter = bits.rbegin(); iter != bits.rend(); ++iter) {
-        ret = (ret << 1) | ((addr >> *iter) & 0x1);
-    }
-    return ret;
+    chan_field = compile_field(chan_bits);
+    rank_field = compile_field(rank_bits);
+    bank_field = compile_field(bank_bits);
+    row_field = compile_field(row_bits);
+    col_field = compile_field(col_bits);
+
+#ifdef MEMBLES_X86_DECODER
+    __builtin_cpu_init();
+    use_pext = __builtin_cpu_supports("bmi2") && chan_field.ascending &&
+               rank_field.ascending && bank_field.ascending &&
+               row_field.ascending && col_field.ascending;
+    use_avx2 = __builtin_cpu_supports("avx2");
+#endif
 }
 
 }
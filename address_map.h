@@ -36,15 +36,51 @@
 namespace membles
 {
 
+/*
+ * A run of contiguous address bits that lands in contiguous field bits
+ */
+struct BitRun
+{
+    uint32_t addr_pos;      // lowest address bit of the run
+    uint32_t field_pos;     // lowest field bit of the run
+    uint64_t mask;          // (1 << run length) - 1
+};
+
+
+/*
+ * An address field (e.g. row) compiled from its list of bit positions
+ */
+struct BitField
+{
+    BitField()
+        : pext_mask(0),
+          ascending(true)
+    {}
+
+    vector<BitRun> runs;
+    // all the address bits of the field
+    uint64_t pext_mask;
+    // true if the field bits keep the address bit order, so that the field
+    //   can be extracted by a single PEXT instruction
+    bool ascending;
+};
+
+
 class AddressMap
 {
 
   public:
     
+    AddressMap();
+
     bool init(CtrlCfg *ctrl_cfg, DevCfg *dev_cfg);
 
     void map(uint64_t addr, uint32_t &chan, uint32_t &rank, uint32_t &bank,
-             uint32_t &row, uint32_t &col);
+             uint32_t &row, uint32_t &col) const;
+
+    // decode an array of addresses, the outputs are arrays of n elements
+    void map(const uint64_t *addrs, size_t n, uint32_t *chan, uint32_t *rank,
+             uint32_t *bank, uint32_t *row, uint32_t *col) const;
 
     void info();
 
@@ -56,9 +92,21 @@ class AddressMap
     vector<uint32_t> row_bits;
     vector<uint32_t> col_bits;
 
+    // the bit lists compiled into mask/shift pairs
+    BitField chan_field;
+    BitField rank_field;
+    BitField bank_field;
+    BitField row_field;
+    BitField col_field;
+
+    // decode with PEXT (BMI2) if the CPU supports it and all fields allow it
+    bool use_pext;
+    // decode address arrays with AVX2 if the CPU supports it
+    bool use_avx2;
+
     void increment(uint32_t &pos);
 
-    uint32_t extract(uint64_t addr, const vector<uint32_t> &bits);
+    void compile();
 };
 
 }
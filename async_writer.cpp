@@ -0,0 +1,183 @@
+/* Copyright (c) 2014, Jue Wang
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <cstring>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "async_writer.h"
+
+namespace membles
+{
+
+/* ctor: Async Writer
+ * Set the page size, nothing is written until open() is called
+ */
+AsyncWriter::AsyncWriter(size_t page_size)
+    : fd_(-1),
+      page_size_(page_size),
+      cur_(0),
+      fill_(0),
+      pending_(false),
+      pending_size_(0),
+      stopping_(false),
+      failed_(false)
+{}
+
+
+/* dtor: Async Writer
+ * Flush and close the file
+ */
+AsyncWriter::~AsyncWriter()
+{
+    close();
+}
+
+
+/*
+ * Create a file and launch the thread
+ */
+bool AsyncWriter::open(const string &filename)
+{
+    assert(fd_ < 0);
+    filename_ = filename;
+    fd_ = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd_ < 0) {
+        ERROR("Cannot open file " << filename << ".");
+        return false;
+    }
+    pages_[0].resize(page_size_);
+    pages_[1].resize(page_size_);
+    cur_ = 0;
+    fill_ = 0;
+    pending_ = false;
+    stopping_ = false;
+    failed_ = false;
+    thread_ = thread(&AsyncWriter::run, this);
+    return true;
+}
+
+
+/*
+ * Hand the last page to the thread, wait for it and close the file
+ */
+bool AsyncWriter::close()
+{
+    if (fd_ < 0) return true;
+    if (fill_) swap();
+    {
+        lock_guard<mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+    ::close(fd_);
+    fd_ = -1;
+    if (failed_) ERROR("Fail to write " << filename_ << ".");
+    return !failed_;
+}
+
+
+/*
+ * Return room for up to len bytes, handing the current page to the thread if
+ *   it is too full
+ */
+char *AsyncWriter::reserve(size_t len)
+{
+    assert(len <= page_size_);
+    if (fill_ + len > page_size_) swap();
+    return pages_[cur_].data() + fill_;
+}
+
+
+/*
+ * Append bytes to the file
+ */
+void AsyncWriter::write(const void *data, size_t len)
+{
+    const char *bytes = (const char *)data;
+    while (len) {
+        size_t chunk = min(len, page_size_);
+        memcpy(reserve(chunk), bytes, chunk);
+        commit(chunk);
+        bytes += chunk;
+        len -= chunk;
+    }
+}
+
+
+/*
+ * Hand the current page to the thread and continue on the other one, which
+ *   has to be written out first
+ */
+void AsyncWriter::swap()
+{
+    unique_lock<mutex> lock(mutex_);
+    while (pending_) cv_.wait(lock);
+    pending_ = true;
+    pending_size_ = fill_;
+    cur_ ^= 1;
+    fill_ = 0;
+    lock.unlock();
+    cv_.notify_all();
+}
+
+
+/*
+ * Thread body: write every handed page until stopped
+ */
+void AsyncWriter::run()
+{
+    unique_lock<mutex> lock(mutex_);
+    while (true) {
+        while (!pending_ && !stopping_) cv_.wait(lock);
+        if (!pending_) break;
+        // the handed page is the one not being filled
+        const char *data = pages_[cur_ ^ 1].data();
+        size_t size = pending_size_;
+        lock.unlock();
+        bool success = true;
+        while (size) {
+            ssize_t len = ::write(fd_, data, size);
+            if (len < 0 && errno == EINTR) continue;
+            if (len <= 0) {
+                success = false;
+                break;
+            }
+            data += len;
+            size -= len;
+        }
+        lock.lock();
+        failed_ |= !success;
+        pending_ = false;
+        cv_.notify_all();
+    }
+}
+
+}
@@ -0,0 +1,102 @@
+/* Copyright (c) 2014, Jue Wang
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef ASYNC_WRITER_H
+#define ASYNC_WRITER_H
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "macro.h"
+
+namespace membles
+{
+
+/*
+ * Write a file on a background thread with two pages
+ * The caller fills one page while the thread writes the other, and only waits
+ *   when it fills a page before the thread is done with the previous one.
+ */
+class AsyncWriter
+{
+
+  public:
+
+    AsyncWriter(size_t page_size = 1 << 20);
+    ~AsyncWriter();
+
+    bool open(const string &filename);
+    // flush everything and close the file
+    // return false if anything failed to be written
+    bool close();
+
+    bool is_open() const { return fd_ >= 0; }
+
+    // get room for up to len bytes at the end of the current page, and
+    //   commit the bytes actually used
+    char *reserve(size_t len);
+    void commit(size_t len) { fill_ += len; }
+
+    void write(const void *data, size_t len);
+
+  private:
+
+    int fd_;
+    string filename_;
+
+    size_t page_size_;
+    vector<char> pages_[2];
+    // the page being filled and its fill level
+    uint32_t cur_;
+    size_t fill_;
+
+    // page handoff, protected by mutex_
+    mutex mutex_;
+    condition_variable cv_;
+    // a page is handed to the thread
+    bool pending_;
+    size_t pending_size_;
+    bool stopping_;
+    bool failed_;
+
+    thread thread_;
+
+    void swap();
+    void run();
+
+    // a file must not be shared
+    AsyncWriter(const AsyncWriter &);
+    AsyncWriter &operator=(const AsyncWriter &);
+
+};
+
+}
+
+#endif
@@ -34,143 +34,127 @@ namespace membles
  */
 Bank::Bank()
     : state_(IDLE),
+      state_from_(0),
+      transient_(IDLE),
       open_row_(0),
       in_use_(false),
+      rank_(0),
+      rank_timing_(nullptr),
+      chan_timing_(nullptr),
       next_rd_(0),
       next_wr_(0),
       next_act_(0),
-      next_pre_(0),
-      next_pd_(0),
-      next_pu_(0),
-      countdown_(0)
+      next_pre_(0)
 {}
 
 
 /*
- * move 1 cycle ahread
- */
-void Bank::step()
-{
-    if (countdown_) {
-        countdown_--;
-        if (countdown_ == 0) {
-            if (state_ == ACTIVATING) {
-                state_ = ACTIVE;
-            } else if (state_ == PRECHARGING) {
-                state_ = IDLE;
-            } else if (state_ == REFRESHING) {
-                state_ = IDLE;
-            } else {
-                ERROR("Counting down during a non-intermediate state");
-            }
-        }
-    }
-    cycle_++;
+ * Initialize the bank by specifying:
+ *   the rank it belongs to
+ *   the timing constraints shared within the rank and the channel
+ *   a controller configuration
+ *   a device configuration
+ *   a set of output stream
+ */
+bool Bank::init(uint32_t rank, RankTiming *rank_timing,
+                ChanTiming *chan_timing, CtrlCfg *ctrl_cfg, DevCfg *dev_cfg,
+                ostream *log, ostream *csv, RecordSink *trc)
+{
+    rank_ = rank;
+    rank_timing_ = rank_timing;
+    chan_timing_ = chan_timing;
+    return MemObj::init(ctrl_cfg, dev_cfg, log, csv, trc);
 }
 
 
 /*
  * Process activate operations
- * Banks not being accessed but attached to the same rank also need to adjust
- *   their status
+ * Other banks in the same rank see the change through the rank-level timing
  */
-void Bank::activate(uint32_t row, bool this_bank, bool this_rank)
+void Bank::activate(uint32_t row, Cycle now)
 {
     // change bank state
-    if (this_bank) {
-        assert(state_ == IDLE);
-        state_ = ACTIVATING;
-        open_row_ = row;
-        countdown_ = dev_cfg_->tRCD();
-    }
+    assert(state(now) == IDLE);
+    transient_ = ACTIVATING;
+    state_ = ACTIVE;
+    state_from_ = now + dev_cfg_->tRCD();
+    open_row_ = row;
     // change timing
-    if (this_bank) {
-        next_rd_ = max(next_rd_, cycle_ + dev_cfg_->tRCD() - dev_cfg_->AL);
-        next_wr_ = max(next_rd_, cycle_ + dev_cfg_->tRCD() - dev_cfg_->AL);
-        next_act_ = max(next_act_, cycle_ + dev_cfg_->tRC());
-        next_pre_ = max(next_pre_, cycle_ + dev_cfg_->tRAS());
-    } else if (this_rank) {
-        next_act_ = max(next_act_, cycle_ + dev_cfg_->tRRD());
-    }
+    next_rd_ = max(next_rd_, now + dev_cfg_->tRCD() - dev_cfg_->AL);
+    next_wr_ = max(next_wr_, now + dev_cfg_->tRCD() - dev_cfg_->AL);
+    next_act_ = max(next_act_, now + dev_cfg_->tRC());
+    next_pre_ = max(next_pre_, now + dev_cfg_->tRAS());
+    rank_timing_->next_act = max(rank_timing_->next_act,
+                                 now + dev_cfg_->tRRD());
 }
 
 
 /*
  * Process precharge operations
- * Banks not being accessed but attached to the same rank also need to adjust
- *   their status
+ * Only this bank is affected
  */
-void Bank::precharge(bool this_bank, bool this_rank)
+void Bank::precharge(Cycle now)
 {
     // change bank state
-    if (this_bank) {
-        assert(state_ == ACTIVE);
-        state_ = PRECHARGING;
-        countdown_ = dev_cfg_->tRP();
-    }
+    assert(state(now) == ACTIVE);
+    transient_ = PRECHARGING;
+    state_ = IDLE;
+    state_from_ = now + dev_cfg_->tRP();
     // change timing
-    if (this_bank) {
-        next_act_ = max(next_act_, cycle_ + dev_cfg_->tRP());
-        next_rd_ = max(next_rd_, next_act_ + dev_cfg_->tRCD());
-        next_wr_ = max(next_wr_, next_act_ + dev_cfg_->tRCD());
-        next_pre_ = max(next_pre_, next_act_ + dev_cfg_->tRAS());
-    }
+    next_act_ = max(next_act_, now + dev_cfg_->tRP());
+    next_rd_ = max(next_rd_, next_act() + dev_cfg_->tRCD());
+    next_wr_ = max(next_wr_, next_act() + dev_cfg_->tRCD());
+    next_pre_ = max(next_pre_, next_act() + dev_cfg_->tRAS());
 }
 
 
 /*
  * Process read operations
- * Banks not being accessed but attached to the same rank also need to adjust
- *   their status
+ * Other banks in the same rank and channel see the change through the
+ *   rank-level and the channel-level timing
  */
-void Bank::read(bool this_bank, bool this_rank)
+void Bank::read(Cycle now)
 {
     // check the bank state
-    if (this_bank) {
-        assert(state_ == ACTIVE);
-    }
+    assert(state(now) == ACTIVE);
     // change timing
-    if (this_rank) {
-        next_rd_ = max(next_rd_, cycle_ + dev_cfg_->tCCD());
-    } else {
-        next_rd_ = max(next_rd_, cycle_ + dev_cfg_->BL / dev_cfg_->data_rate_
-                       + 1); // TODO
-    }
-    next_wr_ = max(next_wr_, cycle_ + dev_cfg_->RdToWr());
-    if (this_bank) {
-        next_pre_ = max(next_pre_, cycle_ + dev_cfg_->RdToPre());
-        next_act_ = max(next_act_, next_pre_ + dev_cfg_->tRP());
+    if (now + dev_cfg_->tCCD() > rank_timing_->next_rd) {
+        rank_timing_->next_rd = now + dev_cfg_->tCCD();
+        rank_timing_->rd_turnaround = false;
     }
-    next_pd_ = max(next_pd_, cycle_); // TODO
-    next_pu_ = max(next_pu_, cycle_); // TODO
+    chan_timing_->other_rd.update(rank_, now + dev_cfg_->BL /
+                                  dev_cfg_->data_rate_ + 1); // TODO
+    chan_timing_->next_wr = max(chan_timing_->next_wr,
+                                now + dev_cfg_->RdToWr());
+    next_pre_ = max(next_pre_, now + dev_cfg_->RdToPre());
+    next_act_ = max(next_act_, next_pre_ + dev_cfg_->tRP());
+    chan_timing_->next_pd = max(chan_timing_->next_pd, now); // TODO
+    chan_timing_->next_pu = max(chan_timing_->next_pu, now); // TODO
 }
 
 
 /*
  * Process write operations
- * Banks not being accessed but attached to the same rank also need to adjust
- *   their status
+ * Other banks in the same rank and channel see the change through the
+ *   rank-level and the channel-level timing
  */
-void Bank::write(bool this_bank, bool this_rank)
+void Bank::write(Cycle now)
 {
     // check the bank state
-    if (this_bank) {
-        assert(state_ == ACTIVE);
-    }
+    assert(state(now) == ACTIVE);
     // change timing
-    next_rd_ = max(next_rd_, cycle_ + dev_cfg_->WrToRd(this_rank));
-    if (this_rank) {
-        next_wr_ = max(next_wr_, cycle_ + dev_cfg_->tCCD());
-    } else {
-        next_wr_ = max(next_wr_, cycle_ + dev_cfg_->BL / dev_cfg_->data_rate_
-                       + 1);
-    }
-    if (this_bank) {
-        next_pre_ = max(next_pre_, cycle_ + dev_cfg_->WrToPre());
-        next_act_ = max(next_act_, next_pre_ + dev_cfg_->tRP());
+    if (now + dev_cfg_->WrToRd(true) > rank_timing_->next_rd) {
+        rank_timing_->next_rd = now + dev_cfg_->WrToRd(true);
+        rank_timing_->rd_turnaround = true;
     }
-    next_pd_ = max(next_pd_, cycle_); // TODO
-    next_pu_ = max(next_pu_, cycle_); // TODO
+    chan_timing_->other_rd.update(rank_, now + dev_cfg_->WrToRd(false));
+    rank_timing_->next_wr = max(rank_timing_->next_wr, now + dev_cfg_->tCCD());
+    chan_timing_->other_wr.update(rank_, now + dev_cfg_->BL /
+                                  dev_cfg_->data_rate_ + 1);
+    next_pre_ = max(next_pre_, now + dev_cfg_->WrToPre());
+    next_act_ = max(next_act_, next_pre_ + dev_cfg_->tRP());
+    chan_timing_->next_pd = max(chan_timing_->next_pd, now); // TODO
+    chan_timing_->next_pu = max(chan_timing_->next_pu, now); // TODO
 }
 
 
@@ -178,17 +162,17 @@ void Bank::write(bool this_bank, bool this_rank)
  * Process a command
  * Just a wrapper
  */
-void Bank::operate(Command *cmd, bool this_bank, bool this_rank)
+void Bank::operate(Command *cmd, Cycle now)
 {
     CmdType type = cmd->type();
     if (type == ACTIVATE) {
-        activate(cmd->row(), this_bank, this_rank);
+        activate(cmd->row(), now);
     } else if (type == PRECHARGE) {
-        precharge(this_bank, this_rank);
+        precharge(now);
     } else if (type == READ) {
-        read(this_bank, this_rank);
+        read(now);
     } else if (type == WRITE) {
-        write(this_bank, this_rank);
+        write(now);
     } else {
         // TODO
     }
@@ -198,20 +182,22 @@ void Bank::operate(Command *cmd, bool this_bank, bool this_rank)
 /*
  * Return the next cycle according to command type
  * e.g. READ -> return next_rd
+ * A command waiting for an ongoing state transition is issuable no earlier
+ *   than the transition completes
  */
-Cycle Bank::next(Command *cmd)
+Cycle Bank::next(Command *cmd) const
 {
     switch (cmd->type()) {
     case READ:
-        return (state_ == ACTIVE && open_row_ == cmd->row()) ? next_rd_ :
-                MAX_CYCLE;
+        return (state_ == ACTIVE && open_row_ == cmd->row()) ?
+                max(next_rd(), state_from_) : MAX_CYCLE;
     case WRITE:
-        return (state_ == ACTIVE && open_row_ == cmd->row()) ? next_wr_ :
-                MAX_CYCLE;
+        return (state_ == ACTIVE && open_row_ == cmd->row()) ?
+                max(next_wr(), state_from_) : MAX_CYCLE;
     case ACTIVATE:
-        return state_ == IDLE ? next_act_ : MAX_CYCLE;
+        return state_ == IDLE ? max(next_act(), state_from_) : MAX_CYCLE;
     case PRECHARGE:
-        return state_ == ACTIVE ? next_pre_ : MAX_CYCLE;
+        return state_ == ACTIVE ? max(next_pre(), state_from_) : MAX_CYCLE;
     default:
         // TODO: lot of others
         return MAX_CYCLE;
@@ -219,30 +205,168 @@ Cycle Bank::next(Command *cmd)
 }
 
 
+/*
+ * Return the constraint that holds a command back until next(cmd), which is
+ *   given as ready, the first one checked on a tie
+ * The bank-level registers are named after the constraint that mostly sets
+ *   them, e.g. tRC is counted as tRP, but a precharge tells tRAS from the
+ *   read or write to precharge delay by the cycle the row is activated.
+ */
+StallCause Bank::limit(Command *cmd, Cycle ready) const
+{
+    switch (cmd->type()) {
+    case READ:
+        if (ready == state_from_ || ready == next_rd_) return STALL_TRCD;
+        if (ready == rank_timing_->next_rd) {
+            return rank_timing_->rd_turnaround ? STALL_TURNAROUND :
+                                                 STALL_TCCD;
+        }
+        return STALL_TURNAROUND;
+    case WRITE:
+        if (ready == state_from_ || ready == next_wr_) return STALL_TRCD;
+        if (ready == rank_timing_->next_wr) return STALL_TCCD;
+        return STALL_TURNAROUND;
+    case ACTIVATE:
+        if (ready == state_from_ || ready == next_act_) return STALL_TRP;
+        return STALL_TRRD;
+    case PRECHARGE:
+        if (ready == state_from_) return STALL_TRCD;
+        // the row is activated at state_from_ - tRCD
+        if (ready == state_from_ + dev_cfg_->tRAS() - dev_cfg_->tRCD())
+            return STALL_TRAS;
+        return STALL_TRTP_TWR;
+    default:
+        // TODO: lot of others
+        return STALL_EMPTY;
+    }
+}
+
+
 /*
  * Return the earliest cycle that issuing a transaction becomes possible
  */
-Cycle Bank::EarliestCycle(uint32_t row, bool is_read)
+Cycle Bank::EarliestCycle(uint32_t row, bool is_read, Cycle now) const
 {
+    BankState cur_state = state(now);
     if (in_use_) {
         // this bank is being used by other transaction
         return MAX_CYCLE;
-    } else if (state_ == ACTIVE) {
+    } else if (cur_state == ACTIVE) {
         // this bank is open, determine whether it's page hit or conflict
         if (open_row_ == row) {
             // page hit
-            return next_rd_;
+            return next_rd();
         } else {
             // page conflict
-            return next_act_ + dev_cfg_->tRCD();
+            return next_act() + dev_cfg_->tRCD();
         }
-    } else if (state_ == IDLE) {
+    } else if (cur_state == IDLE) {
         // this bank is close, it's page miss
-        return next_act_ + dev_cfg_->tRCD();
+        return next_act() + dev_cfg_->tRCD();
     } else {
         // TODO: further model power-down, self-refresh
-        return cycle_;
+        return now;
     }
 }
 
+
+/*
+ * Save the state and the timing registers of the bank
+ */
+void Bank::save(CheckpointWriter &out) const
+{
+    out.put(state_);
+    out.put(state_from_);
+    out.put(transient_);
+    out.put(open_row_);
+    out.put(in_use_);
+    out.put(next_rd_);
+    out.put(next_wr_);
+    out.put(next_act_);
+    out.put(next_pre_);
+}
+
+
+/*
+ * Restore what save() wrote
+ */
+void Bank::restore(CheckpointReader &in)
+{
+    state_ = (BankState)in.get();
+    state_from_ = in.get();
+    transient_ = (BankState)in.get();
+    open_row_ = in.get();
+    in_use_ = in.get();
+    next_rd_ = in.get();
+    next_wr_ = in.get();
+    next_act_ = in.get();
+    next_pre_ = in.get();
+}
+
+
+/*
+ * Set the row buffer directly, e.g. when fast-forwarding a trace
+ */
+void Bank::warm(uint32_t row)
+{
+    assert(!in_use_);
+    state_ = transient_ = (row == NO_ROW) ? IDLE : ACTIVE;
+    state_from_ = 0;
+    if (row != NO_ROW) open_row_ = row;
+}
+
+
+/*
+ * Go back to the initial state, the timing shared with the rank and the
+ *   channel is reset by the channel
+ */
+void Bank::reset()
+{
+    assert(!in_use_);
+    state_ = transient_ = IDLE;
+    state_from_ = 0;
+    open_row_ = 0;
+    next_rd_ = 0;
+    next_wr_ = 0;
+    next_act_ = 0;
+    next_pre_ = 0;
+    cycle_ = 0;
+}
+
+
+/*
+ * Record a constraint set by a rank
+ */
+void OtherRankCycle::update(uint32_t rank, Cycle cycle)
+{
+    if (rank == first_rank_) {
+        first_ = max(first_, cycle);
+    } else if (cycle > first_) {
+        second_ = first_;
+        first_ = cycle;
+        first_rank_ = rank;
+    } else {
+        second_ = max(second_, cycle);
+    }
+}
+
+
+/*
+ * Save and restore the recorded constraints
+ */
+void OtherRankCycle::save(CheckpointWriter &out) const
+{
+    out.put(first_);
+    out.put(first_rank_);
+    out.put(second_);
+}
+
+
+void OtherRankCycle::restore(CheckpointReader &in)
+{
+    first_ = in.get();
+    first_rank_ = in.get();
+    second_ = in.get();
+}
+
 }
@@ -30,10 +30,15 @@
 #include "macro.h"
 #include "base_obj.h"
 #include "command.h"
+#include "checkpoint.h"
+#include "stats.h"
 
 namespace membles
 {
 
+// the row of a closed bank
+const uint32_t NO_ROW = UINT32_MAX;
+
 // different states in memory state machine
 enum BankState {
     IDLE,
@@ -47,6 +52,82 @@ enum BankState {
 };
 
 
+/*
+ * Timing constraints shared by all the banks in a rank
+ */
+struct RankTiming
+{
+    RankTiming()
+        : next_rd(0),
+          next_wr(0),
+          next_act(0),
+          rd_turnaround(false)
+    {}
+
+    Cycle next_rd;      // tCCD, write-to-read turnaround
+    Cycle next_wr;      // tCCD
+    Cycle next_act;     // tRRD
+    // whether next_rd is set by the write-to-read turnaround
+    bool rd_turnaround;
+};
+
+
+/*
+ * The latest cycle set by rank-to-rank switching constraints
+ * Only the largest value and the largest value set by some other rank are
+ *   kept, so the constraint imposed on a rank by all the other ranks can be
+ *   looked up without walking every rank
+ */
+class OtherRankCycle
+{
+
+  public:
+
+    OtherRankCycle()
+        : first_(0),
+          first_rank_(0),
+          second_(0)
+    {}
+
+    void update(uint32_t rank, Cycle cycle);
+    Cycle get(uint32_t rank) const {
+        return rank == first_rank_ ? second_ : first_;
+    }
+
+    void save(CheckpointWriter &out) const;
+    void restore(CheckpointReader &in);
+
+  private:
+
+    // the largest cycle and the rank that set it
+    Cycle first_;
+    uint32_t first_rank_;
+    // the largest cycle set by any rank other than first_rank_
+    Cycle second_;
+
+};
+
+
+/*
+ * Timing constraints shared by all the banks in a channel
+ */
+struct ChanTiming
+{
+    ChanTiming()
+        : next_wr(0),
+          next_pd(0),
+          next_pu(0)
+    {}
+
+    Cycle next_wr;      // read-to-write turnaround
+    Cycle next_pd;      // power-down
+    Cycle next_pu;      // exit power-down
+    // rank-to-rank switching
+    OtherRankCycle other_rd;
+    OtherRankCycle other_wr;
+};
+
+
 class Bank : public MemObj
 {
 
@@ -54,27 +135,50 @@ class Bank : public MemObj
 
     Bank();
 
-    void step();
+    bool init(uint32_t rank, RankTiming *rank_timing, ChanTiming *chan_timing,
+              CtrlCfg *ctrl_cfg, DevCfg *dev_cfg,
+              ostream *log, ostream *csv, RecordSink *trc);
+
+    // a bank derives its state from timestamps whenever it is asked, so there
+    //   is nothing to do on a per-cycle basis
+    void step() {}
+    Cycle NextEvent() const { return MAX_CYCLE; }
 
     // accessors
-    BankState state() const { return state_; }
+    BankState state(Cycle now) const {
+        return now < state_from_ ? transient_ : state_;
+    }
     uint32_t open_row() const { return open_row_; }
     bool in_use() const { return in_use_; }
 
     void use() { in_use_ = true; }
     void release() { in_use_ = false; }
-    void activate(uint32_t row, bool this_bank = true, bool this_rank = true);
-    void precharge(bool this_bank = true, bool this_rank = true);
-    void read(bool this_bank = true, bool this_rank = true);
-    void write(bool this_bank = true, bool this_rank = true);
-    void operate(Command *cmd, bool this_bank = true, bool this_rank = true);
+    void activate(uint32_t row, Cycle now);
+    void precharge(Cycle now);
+    void read(Cycle now);
+    void write(Cycle now);
+    void operate(Command *cmd, Cycle now);
+
+    Cycle next(Command *cmd) const;
+    StallCause limit(Command *cmd, Cycle ready) const;
+    Cycle EarliestCycle(uint32_t row, bool is_read, Cycle now) const;
 
-    Cycle next(Command *cmd);
-    Cycle EarliestCycle(uint32_t row, bool is_read);
+    void save(CheckpointWriter &out) const;
+    void restore(CheckpointReader &in);
+
+    // open a row (or close the bank with NO_ROW) without any timing, which
+    //   only works on an idle bank
+    void warm(uint32_t row);
+    // forget everything, as if the bank is just initialized
+    void reset();
 
   private:
 
+    // the state the bank settles in, valid from cycle state_from_ on
     BankState state_;
+    Cycle state_from_;
+    // the intermediate state before state_from_, e.g. ACTIVATING
+    BankState transient_;
 
     // indicate which row is opened in this bank
     uint32_t open_row_;
@@ -82,18 +186,32 @@ class Bank : public MemObj
     // indicate whether this bank is being used for a transaction
     bool in_use_;
 
-    // the earliest cycle that a command is allowed
+    // the rank this bank belongs to
+    uint32_t rank_;
+
+    // constraints shared with the other banks of the same rank and channel
+    RankTiming *rank_timing_;
+    ChanTiming *chan_timing_;
+
+    // the earliest cycle that a command is allowed by this bank alone
     Cycle next_rd_;     // read
     Cycle next_wr_;     // normal write
     //Cycle next_mwr_;    // mask write
     Cycle next_act_;    // activate
     Cycle next_pre_;    // precharge
-    Cycle next_pd_;     // power-down
-    Cycle next_pu_;     // exit power-down
 
-    // if the state machine is going to switch to another state automatically,
-    //   we set a countdown here
-    Cycle countdown_;
+    // the earliest cycle that a command is allowed considering all the levels
+    Cycle next_rd() const {
+        return max(max(next_rd_, rank_timing_->next_rd),
+                   chan_timing_->other_rd.get(rank_));
+    }
+    Cycle next_wr() const {
+        return max(max(next_wr_, rank_timing_->next_wr),
+                   max(chan_timing_->next_wr,
+                       chan_timing_->other_wr.get(rank_)));
+    }
+    Cycle next_act() const { return max(next_act_, rank_timing_->next_act); }
+    Cycle next_pre() const { return next_pre_; }
 
 };
 
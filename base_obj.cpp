@@ -37,7 +37,7 @@ namespace membles
  */
 
 bool MemObj::init(CtrlCfg *ctrl_cfg, DevCfg *dev_cfg,
-                  ofstream *log, ofstream *csv, ofstream *trc)
+                  ostream *log, ostream *csv, RecordSink *trc)
 {
     ctrl_cfg_ = ctrl_cfg;
     dev_cfg_ = dev_cfg;
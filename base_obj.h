@@ -31,6 +31,7 @@
 
 #include "controller_config.h"
 #include "device_config.h"
+#include "output.h"
 
 namespace membles
 {
@@ -51,6 +52,11 @@ class BaseObj
 
     virtual void step() = 0;
 
+    // earliest cycle whose step() does more than advancing the clock
+    virtual Cycle NextEvent() const = 0;
+    // jump to a cycle without stepping through the idle cycles in between
+    virtual void SkipTo(Cycle cycle) { cycle_ = cycle; }
+
     Cycle cycle() const { return cycle_; }
     bool busy() const { return busy_; }
     void set_verbose() { verbose_ = true; }
@@ -58,11 +64,11 @@ class BaseObj
   protected:
 
     // log output
-    ofstream *log_;
+    ostream *log_;
     // csv output
-    ofstream *csv_;
-    // trace output
-    ofstream *trc_;
+    ostream *csv_;
+    // command and transaction records
+    RecordSink *trc_;
     // current simulated cycle
     Cycle cycle_;
     // busy doing something
@@ -85,7 +91,7 @@ class MemObj : public BaseObj
     {}
 
     bool init(CtrlCfg *ctrl_cfg, DevCfg *dev_cfg,
-              ofstream *log, ofstream *csv, ofstream *trc);
+              ostream *log, ostream *csv, RecordSink *trc);
 
   protected:
 
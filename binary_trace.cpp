@@ -0,0 +1,385 @@
+/* Copyright (c) 2014, Jue Wang
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <cstdint>
+#include <cstring>
+
+#include <sys/stat.h>
+
+#include "binary_trace.h"
+
+namespace membles
+{
+
+/*
+ * Helpers of the encoding
+ */
+static inline uint64_t ZigZag(uint64_t delta)
+{
+    return (delta << 1) ^ (uint64_t)((int64_t)delta >> 63);
+}
+
+static inline uint64_t UnZigZag(uint64_t val)
+{
+    return (val >> 1) ^ (~(val & 1) + 1);
+}
+
+static inline void PutVarint(vector<uint8_t> &buf, uint64_t val)
+{
+    while (val >= 0x80) {
+        buf.push_back((uint8_t)val | 0x80);
+        val >>= 7;
+    }
+    buf.push_back((uint8_t)val);
+}
+
+// return false if the buffer runs out or the varint is too long
+static inline bool GetVarint(const vector<uint8_t> &buf, size_t &pos,
+                             uint64_t &val)
+{
+    uint64_t result = 0;
+    for (uint32_t shift = 0; shift < 64 && pos < buf.size(); shift += 7) {
+        uint8_t byte = buf[pos++];
+        result |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            val = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+static inline void PutU32(char *buf, uint32_t val)
+{
+    for (size_t i = 0; i < 4; ++i) buf[i] = (char)(val >> (8 * i));
+}
+
+static inline uint32_t GetU32(const char *buf)
+{
+    uint32_t val = 0;
+    for (size_t i = 0; i < 4; ++i) val |= (uint32_t)(uint8_t)buf[i] << (8 * i);
+    return val;
+}
+
+static inline uint64_t gcd(uint64_t a, uint64_t b)
+{
+    while (b) {
+        uint64_t r = a % b;
+        a = b;
+        b = r;
+    }
+    return a;
+}
+
+// size code of a length, 0 means the length is stored on its own
+static inline uint32_t SizeCode(uint32_t len)
+{
+    if (len == 0 || (len & (len - 1))) return 0;
+    uint32_t code = __builtin_ctz(len) + 1;
+    return code < MARKER_SIZE_CODE ? code : 0;
+}
+
+
+/*
+ * Check the magic of a file
+ * Only regular files are checked, since peeking at a pipe would eat its data
+ */
+bool IsBinaryTrace(const string &filename)
+{
+    struct stat st;
+    if (stat(filename.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) return false;
+    ifstream file(filename.c_str(), ios_base::in | ios_base::binary);
+    char magic[sizeof(BIN_TRACE_MAGIC)];
+    if (!file.read(magic, sizeof(magic))) return false;
+    return memcmp(magic, BIN_TRACE_MAGIC, sizeof(magic)) == 0;
+}
+
+
+/* ctor: Binary Trace Reader
+ * No block is loaded until the first record is asked for
+ */
+BinaryTraceReader::BinaryTraceReader()
+    : version_(BIN_TRACE_VERSION),
+      pos_(0),
+      num_left_(0),
+      prev_time_(0),
+      prev_addr_(0),
+      time_unit_(1),
+      addr_shift_(0)
+{}
+
+
+/*
+ * Open a binary trace and check its header
+ */
+bool BinaryTraceReader::open(const string &filename)
+{
+    filename_ = filename;
+    file_.open(filename.c_str(), ios_base::in | ios_base::binary);
+    if (!file_.is_open()) {
+        ERROR("Could not open trace file <" << filename << ">.");
+        return false;
+    }
+    char header[12];
+    if (!file_.read(header, sizeof(header)) ||
+            memcmp(header, BIN_TRACE_MAGIC, sizeof(BIN_TRACE_MAGIC)) != 0) {
+        ERROR(filename << " is not a binary trace.");
+        return false;
+    }
+    version_ = (uint8_t)header[4] | ((uint8_t)header[5] << 8);
+    if (version_ == 0 || version_ > BIN_TRACE_VERSION) {
+        ERROR(filename << " is a version " << version_ << " binary trace, "
+              "while versions up to " << BIN_TRACE_VERSION
+              << " are supported.");
+        return false;
+    }
+    return true;
+}
+
+
+/*
+ * Decode the next record, loading the next block if necessary
+ */
+bool BinaryTraceReader::next(TraceRecord &record)
+{
+    while (num_left_ == 0) {
+        if (!ReadBlock()) return false;
+    }
+    uint64_t time_delta, addr_delta, packed, len;
+    if (!GetVarint(block_, pos_, time_delta) ||
+            !GetVarint(block_, pos_, addr_delta) ||
+            !GetVarint(block_, pos_, packed)) {
+        ERROR(filename_ << " has a corrupted block.");
+        num_left_ = 0;
+        return false;
+    }
+    uint32_t size_code = (packed >> 1) & 0x1f;
+    bool is_marker = false;
+    if (size_code == MARKER_SIZE_CODE && version_ > 1) {
+        is_marker = true;
+        len = 0;
+    } else if (size_code) {
+        len = 1ULL << (size_code - 1);
+    } else if (!GetVarint(block_, pos_, len)) {
+        ERROR(filename_ << " has a corrupted block.");
+        num_left_ = 0;
+        return false;
+    }
+    prev_time_ += UnZigZag(time_delta) * time_unit_;
+    prev_addr_ += UnZigZag(addr_delta) << addr_shift_;
+    record.time = prev_time_;
+    record.addr = prev_addr_;
+    record.len = len;
+    record.is_read = packed & 1;
+    record.priority = packed >> 6;
+    record.marker = NO_MARKER;
+    if (is_marker || (len == 0 && version_ == 1)) {
+        record.marker = (TraceMarker)record.priority;
+        record.priority = 0;
+    }
+    num_left_--;
+    return true;
+}
+
+
+/*
+ * Skip whole blocks by their headers without decoding them
+ */
+uint64_t BinaryTraceReader::skip(uint64_t count)
+{
+    uint64_t skipped = 0;
+    // finish the current block
+    skipped += TraceReader::skip(min(count, (uint64_t)num_left_));
+    while (num_left_ == 0 && skipped < count) {
+        streampos block_pos = file_.tellg();
+        char header[16];
+        if (!file_.read(header, sizeof(header))) break;
+        uint32_t num_records = GetU32(header);
+        if (skipped + num_records > count) {
+            // the position is inside this block, decode it
+            file_.seekg(block_pos);
+            break;
+        }
+        file_.seekg(GetU32(header + 4), ios_base::cur);
+        skipped += num_records;
+    }
+    return skipped + TraceReader::skip(count - skipped);
+}
+
+
+/*
+ * Load the payload of the next block
+ * Return false at the end of the file or if the block is truncated
+ */
+bool BinaryTraceReader::ReadBlock()
+{
+    char header[16];
+    if (!file_.read(header, sizeof(header))) return false;
+    num_left_ = GetU32(header);
+    block_.resize(GetU32(header + 4));
+    time_unit_ = GetU32(header + 8);
+    addr_shift_ = (uint8_t)header[12];
+    if (time_unit_ == 0 || addr_shift_ >= 64) {
+        ERROR(filename_ << " has a corrupted block.");
+        num_left_ = 0;
+        return false;
+    }
+    if (!file_.read((char *)block_.data(), block_.size())) {
+        ERROR(filename_ << " has a truncated block.");
+        num_left_ = 0;
+        return false;
+    }
+    pos_ = 0;
+    prev_time_ = 0;
+    prev_addr_ = 0;
+    return true;
+}
+
+
+/* ctor: Binary Trace Writer
+ * Set the max number of records per block
+ */
+BinaryTraceWriter::BinaryTraceWriter(uint32_t block_size)
+    : block_size_(block_size)
+{
+    records_.reserve(block_size_);
+}
+
+
+/* dtor: Binary Trace Writer
+ * Write the last block
+ */
+BinaryTraceWriter::~BinaryTraceWriter()
+{
+    close();
+}
+
+
+/*
+ * Create a binary trace and write its header
+ */
+bool BinaryTraceWriter::open(const string &filename)
+{
+    file_.open(filename.c_str(),
+               ios_base::out | ios_base::trunc | ios_base::binary);
+    if (!file_.is_open()) {
+        ERROR("Cannot open file " << filename << ".");
+        return false;
+    }
+    char header[12] = {0};
+    memcpy(header, BIN_TRACE_MAGIC, sizeof(BIN_TRACE_MAGIC));
+    header[4] = (char)BIN_TRACE_VERSION;
+    header[5] = (char)(BIN_TRACE_VERSION >> 8);
+    PutU32(header + 8, block_size_);
+    file_.write(header, sizeof(header));
+    return file_.good();
+}
+
+
+/*
+ * Append a record to the current block
+ */
+void BinaryTraceWriter::write(const TraceRecord &record)
+{
+    records_.push_back(record);
+    if (records_.size() == block_size_) WriteBlock();
+}
+
+
+/*
+ * Write the last block and close the file
+ * Return false if anything failed to be written
+ */
+bool BinaryTraceWriter::close()
+{
+    if (!file_.is_open()) return true;
+    if (!records_.empty()) WriteBlock();
+    bool success = file_.good();
+    file_.close();
+    return success;
+}
+
+
+/*
+ * Encode the current block, write it and start a new one
+ */
+void BinaryTraceWriter::WriteBlock()
+{
+    // find the scaling that divides every delta
+    uint64_t time_unit = 0;
+    uint64_t addr_bits = 0;
+    uint64_t prev_time = 0;
+    uint64_t prev_addr = 0;
+    for (auto &record : records_) {
+        if (record.marker) continue;
+        uint64_t time_delta = record.time - prev_time;
+        if ((int64_t)time_delta < 0) time_delta = -time_delta;
+        time_unit = gcd(time_unit, time_delta);
+        addr_bits |= record.addr - prev_addr;
+        prev_time = record.time;
+        prev_addr = record.addr;
+    }
+    if (time_unit == 0 || time_unit > UINT32_MAX) time_unit = 1;
+    uint32_t addr_shift = addr_bits ? __builtin_ctzll(addr_bits) : 0;
+
+    // encode the records
+    block_.clear();
+    prev_time = 0;
+    prev_addr = 0;
+    for (auto &record : records_) {
+        if (record.marker) {
+            // a marker stays where the previous record is
+            PutVarint(block_, 0);
+            PutVarint(block_, 0);
+            PutVarint(block_, (MARKER_SIZE_CODE << 1) |
+                              ((uint64_t)record.marker << 6));
+            continue;
+        }
+        uint32_t size_code = SizeCode(record.len);
+        uint64_t time_delta = (int64_t)(record.time - prev_time) /
+                (int64_t)time_unit;
+        uint64_t addr_delta = (int64_t)(record.addr - prev_addr) >> addr_shift;
+        PutVarint(block_, ZigZag(time_delta));
+        PutVarint(block_, ZigZag(addr_delta));
+        PutVarint(block_, (uint64_t)record.is_read | (size_code << 1) |
+                          ((uint64_t)record.priority << 6));
+        if (!size_code) PutVarint(block_, record.len);
+        prev_time = record.time;
+        prev_addr = record.addr;
+    }
+
+    char header[16] = {0};
+    PutU32(header, records_.size());
+    PutU32(header + 4, block_.size());
+    PutU32(header + 8, time_unit);
+    header[12] = (char)addr_shift;
+    file_.write(header, sizeof(header));
+    file_.write((const char *)block_.data(), block_.size());
+    records_.clear();
+}
+
+}
@@ -0,0 +1,140 @@
+/* Copyright (c) 2014, Jue Wang
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef BINARY_TRACE_H
+#define BINARY_TRACE_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+
+#include "macro.h"
+#include "trace.h"
+
+namespace membles
+{
+
+/*
+ * Binary trace format, all integers are little-endian
+ *   file header: magic "MBTR", version (u16), reserved (u16),
+ *                max records per block (u32)
+ *   block:       number of records (u32), payload size in bytes (u32),
+ *                time unit (u32), address shift (u8), reserved (3 bytes),
+ *                payload
+ * Every record in a payload is a sequence of varints:
+ *   time delta / time unit (zigzag), address delta >> address shift (zigzag),
+ *   is_read | size code << 1 | priority << 6,
+ *   length, only present if the size code is 0
+ * A marker is a record of size code MARKER_SIZE_CODE carrying its kind in the
+ *   priority field, and both of its deltas are 0. Version 1 marks them with
+ *   a length of 0 instead, which is still read.
+ * The time unit and the address shift are the largest ones that divide every
+ *   delta of the block, e.g. 1000ps and 64B for a trace of cache lines issued
+ *   at nanosecond granularity. The size code of a power-of-2 length is
+ *   log2(length) + 1, which fits 5 bits up to 512MB. Deltas restart from zero
+ *   at every block, so each block decodes on its own.
+ */
+const char BIN_TRACE_MAGIC[4] = {'M', 'B', 'T', 'R'};
+const uint16_t BIN_TRACE_VERSION = 2;
+const uint32_t MARKER_SIZE_CODE = 31;
+
+bool IsBinaryTrace(const string &filename);
+
+
+/*
+ * Stream a binary trace one block at a time
+ */
+class BinaryTraceReader : public TraceReader
+{
+
+  public:
+
+    BinaryTraceReader();
+
+    bool open(const string &filename);
+
+    bool next(TraceRecord &record);
+    uint64_t skip(uint64_t count);
+
+  private:
+
+    ifstream file_;
+    string filename_;
+    uint16_t version_;
+
+    // payload of the current block
+    vector<uint8_t> block_;
+    size_t pos_;
+    // number of records left in the current block
+    uint32_t num_left_;
+
+    // the previous record of the current block
+    uint64_t prev_time_;
+    uint64_t prev_addr_;
+
+    // scaling of the deltas in the current block
+    uint32_t time_unit_;
+    uint32_t addr_shift_;
+
+    bool ReadBlock();
+
+};
+
+
+/*
+ * Write a binary trace, the last block is written by close()
+ */
+class BinaryTraceWriter
+{
+
+  public:
+
+    BinaryTraceWriter(uint32_t block_size = 4096);
+    ~BinaryTraceWriter();
+
+    bool open(const string &filename);
+    void write(const TraceRecord &record);
+    bool close();
+
+  private:
+
+    ofstream file_;
+
+    // max number of records per block
+    uint32_t block_size_;
+
+    // records of the current block, which are encoded once the block is full
+    vector<TraceRecord> records_;
+    vector<uint8_t> block_;
+
+    void WriteBlock();
+
+};
+
+}
+
+#endif
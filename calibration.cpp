@@ -0,0 +1,219 @@
+/* Copyright (c) 2014, Jue Wang
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <chrono>
+#include <iomanip>
+
+#include "calibration.h"
+#include "memory_system.h"
+#include "driver.h"
+#include "output.h"
+#include "command.h"
+
+namespace membles
+{
+
+/*
+ * Measure every transaction of a replay from its records
+ */
+class RunStats : public RecordSink
+{
+
+  public:
+
+    RunStats()
+        : num_act_(0),
+          num_rd_(0),
+          num_wr_(0),
+          bytes_(0),
+          rd_latency_(0),
+          wr_latency_(0)
+    {}
+
+    void command(const CmdRecord &record)
+    {
+        if (record.type == ACTIVATE) num_act_++;
+    }
+
+    void retire(const TxRecord &record)
+    {
+        Cycle latency = record.finish_cycle - record.arrive_cycle;
+        if (record.is_read) {
+            num_rd_++;
+            rd_latency_ += latency;
+        } else {
+            num_wr_++;
+            wr_latency_ += latency;
+        }
+        bytes_ += record.len;
+    }
+
+    void measure(Cycle cycles, Frequency freq, RunMetrics &metrics) const
+    {
+        uint64_t num_tx = num_rd_ + num_wr_;
+        metrics.cycles = cycles;
+        metrics.rd_latency = num_rd_ ? (double)rd_latency_ / num_rd_ : 0;
+        metrics.wr_latency = num_wr_ ? (double)wr_latency_ / num_wr_ : 0;
+        metrics.row_hit_rate = num_tx ? 1.0 - (double)num_act_ / num_tx : 0;
+        // bytes per cycle * MHz = MB/s
+        metrics.bandwidth = cycles ? (double)bytes_ / cycles * freq / 1e3 : 0;
+    }
+
+  private:
+
+    uint64_t num_act_;
+    uint64_t num_rd_;
+    uint64_t num_wr_;
+    uint64_t bytes_;
+    uint64_t rd_latency_;
+    uint64_t wr_latency_;
+
+};
+
+
+/*
+ * Replay a trace in simulation or in fast mode
+ */
+static bool Replay(const string &ctrl_filename,
+                   const vector<string> &dev_filenames,
+                   const vector<uint64_t> &sizes,
+                   const vector<TraceRecord> &trace, bool fast,
+                   RunMetrics &metrics)
+{
+    MemorySystem membles;
+    RunStats stats;
+    membles.set_sink(&stats);
+    if (fast) membles.set_fast();
+    if (!membles.init(ctrl_filename, dev_filenames, sizes)) return false;
+    MemTraceReader reader(trace);
+    Driver driver(&membles, &reader);
+    auto start = chrono::steady_clock::now();
+    Cycle cycles = driver.run();
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    stats.measure(cycles, membles.freq(), metrics);
+    metrics.seconds = elapsed.count();
+    return true;
+}
+
+
+/*
+ * Relative error of an approximation in percent
+ */
+static double Error(double approx, double exact)
+{
+    return exact ? 100 * (approx - exact) / exact : 0;
+}
+
+
+/* ctor: Calibration
+ */
+Calibration::Calibration()
+    : num_tx_(0),
+      num_split_(0)
+{}
+
+
+/*
+ * Load a trace and replay it in both ways
+ * Return false if the memory system cannot be set up
+ */
+bool Calibration::run(const string &ctrl_filename,
+                      const vector<string> &dev_filenames,
+                      const vector<uint64_t> &sizes,
+                      TraceReader *reader)
+{
+    // the memory system knowing the MAL of every channel
+    MemorySystem membles;
+    if (!membles.init(ctrl_filename, dev_filenames, sizes)) return false;
+
+    num_tx_ = 0;
+    num_split_ = 0;
+    vector<TraceRecord> trace;
+    TraceRecord record;
+    while (reader->next(record)) {
+        if (record.marker != NO_MARKER) {
+            trace.push_back(record);
+            continue;
+        }
+        num_tx_++;
+        uint64_t addr = record.addr;
+        uint32_t len = record.len;
+        uint32_t mal = membles.mal(addr);
+        align(addr, len, mal);
+        for (uint32_t offset = 0; offset < len; offset += mal) {
+            record.addr = addr + offset;
+            record.len = mal;
+            trace.push_back(record);
+            num_split_++;
+        }
+    }
+
+    return Replay(ctrl_filename, dev_filenames, sizes, trace, false, sim_) &&
+           Replay(ctrl_filename, dev_filenames, sizes, trace, true, fast_);
+}
+
+
+/*
+ * Print the metrics of both replays side by side
+ */
+void Calibration::report(ostream &os) const
+{
+    const char *names[] = {
+        "Cycles:             ", "Read latency:       ", "Write latency:      ",
+        "Row-hit rate:       ", "Bandwidth (GB/s):   "
+    };
+    double sim[] = {
+        (double)sim_.cycles, sim_.rd_latency, sim_.wr_latency,
+        sim_.row_hit_rate, sim_.bandwidth
+    };
+    double fast[] = {
+        (double)fast_.cycles, fast_.rd_latency, fast_.wr_latency,
+        fast_.row_hit_rate, fast_.bandwidth
+    };
+
+    ios_base::fmtflags flags = os.flags();
+    streamsize precision = os.precision();
+    os << "   Transactions: " << num_tx_ << ", " << num_split_
+       << " after splitting into MAL" << endl;
+    os << "                       " << setw(14) << "Simulation" << setw(14)
+       << "Fast" << setw(10) << "Error" << endl;
+    os << fixed;
+    for (size_t i = 0; i < 5; ++i) {
+        // cycles are whole numbers
+        os << "   " << names[i] << setprecision(i ? 4 : 0) << setw(14) << sim[i]
+           << setw(14) << fast[i] << setprecision(2) << setw(9)
+           << Error(fast[i], sim[i]) << "%" << endl;
+    }
+    os << "   Run time (s):       " << setprecision(4) << setw(14)
+       << sim_.seconds << setw(14) << fast_.seconds << setprecision(1)
+       << setw(9) << (fast_.seconds ? sim_.seconds / fast_.seconds : 0)
+       << "x" << endl;
+    os.flags(flags);
+    os.precision(precision);
+}
+
+}
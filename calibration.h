@@ -0,0 +1,93 @@
+/* Copyright (c) 2014, Jue Wang
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef CALIBRATION_H
+#define CALIBRATION_H
+
+#include <string>
+#include <vector>
+#include <ostream>
+
+#include "macro.h"
+#include "trace.h"
+
+namespace membles
+{
+
+/*
+ * What a replay of the whole trace measures
+ */
+struct RunMetrics {
+    Cycle cycles;
+    // cycles between acceptance and retirement
+    double rd_latency;
+    double wr_latency;
+    // fraction of transactions that need no activation
+    double row_hit_rate;
+    // GB/s
+    double bandwidth;
+    // wall-clock time of the replay, unit: second
+    double seconds;
+};
+
+
+/*
+ * Calibrate the approximate timing of fast mode: the same trace is replayed
+ *   once in simulation and once in fast mode, and the metrics of fast mode
+ *   are reported with their error against simulation
+ * Simulation only takes MAL-sized transactions, so every transaction of the
+ *   trace is split into MAL-sized ones for both replays, and the trace is
+ *   loaded in memory first so the replays are timed without the trace input
+ */
+class Calibration
+{
+
+  public:
+
+    Calibration();
+
+    bool run(const string &ctrl_filename,
+             const vector<string> &dev_filenames,
+             const vector<uint64_t> &sizes,
+             TraceReader *reader);
+
+    void report(ostream &os) const;
+
+  private:
+
+    RunMetrics sim_;
+    RunMetrics fast_;
+
+    // number of transactions in the trace and after splitting
+    uint64_t num_tx_;
+    uint64_t num_split_;
+
+};
+
+}
+
+#endif
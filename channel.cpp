@@ -24,33 +24,37 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <thread>
+#include <algorithm>
+
 #include "channel.h"
 
 namespace membles
 {
 
 /* ctor: Channel
- * Pass address mapper and bank table references to scheduler
+ * Pass bank table reference to scheduler
  */
 Channel::Channel()
-    : sched_(this, mapper_, banks_)
+    : tx_pool_(nullptr),
+      retire_queue_(nullptr),
+      read_done_(nullptr),
+      write_done_(nullptr),
+      sched_(this, banks_),
+      wr_draining_(false),
+      dispatched_(false),
+      dispatch_stall_(STALL_EMPTY),
+      dispatch_bank_(NO_BANK),
+      next_epoch_(MAX_CYCLE)
 {}
 
 
 /* dtor: Channel
- * Delete any remaining transactions in the read and the write queues
+ * Remaining transactions and commands belong to the pools of the memory
+ *   system, which release them all at once
  */
 Channel::~Channel()
-{
-    while (!rd_queue_.empty()) {
-        if (rd_queue_.back()) delete rd_queue_.back();
-        rd_queue_.pop_back();
-    }
-    while (!wr_queue_.empty()) {
-        if (wr_queue_.back()) delete wr_queue_.back();
-        wr_queue_.pop_back();
-    }
-}
+{}
 
 
 /*
@@ -58,35 +62,106 @@ Channel::~Channel()
  */
 void Channel::step()
 {
+    if (next_epoch_ <= cycle_) EndEpoch();
+    stats_.occupy(occupancy(true), occupancy(false), wr_draining_, 1);
+    if (sched_.NextEvent() > cycle_) stall(1);
     sched_.step();
-    for (auto &b1 : banks_) {
-        for (auto &b2 : b1) {
-            b2.step();
-        }
-    }
+    if (sched_.issued()) stats_.issue();
     //INFO("rd: " << rd_queue_.size() << "+" << rd_resp_queue_.size());
 
     // TODO
     cycle_++;
 
-    DispatchTransaction();
+    dispatched_ = DispatchTransaction();
+}
+
+
+/*
+ * Return the earliest cycle that the channel has something to do
+ * A failed dispatch can only succeed again after a command is issued, which
+ *   is covered by the scheduler. Banks that are not in use never sit in an
+ *   intermediate state, so bank state transitions are no events here.
+ */
+Cycle Channel::NextEvent() const
+{
+    if (dispatched_ && (!rd_queue_.empty() || !wr_queue_.empty()))
+        return cycle_;
+    return sched_.NextEvent();
+}
+
+
+/*
+ * Jump to a cycle, which must be no later than NextEvent()
+ */
+void Channel::SkipTo(Cycle cycle)
+{
+    // the skipped cycles count towards the epochs they fall in
+    size_t num_rd = occupancy(true);
+    size_t num_wr = occupancy(false);
+    Cycle from = cycle_;
+    while (next_epoch_ <= cycle) {
+        stats_.occupy(num_rd, num_wr, wr_draining_, next_epoch_ - from);
+        from = next_epoch_;
+        EndEpoch();
+    }
+    stats_.occupy(num_rd, num_wr, wr_draining_, cycle - from);
+    if (cycle > cycle_) stall(cycle - cycle_);
+    sched_.SkipTo(cycle);
+    cycle_ = cycle;
+}
+
+
+/*
+ * Charge idle command bus cycles to what holds back the queued commands
+ * A transaction for a free bank that waits for room in the command queue
+ *   comes first, since its commands might go right away. A transaction for a
+ *   bank in use could only queue behind the commands of that bank, so it
+ *   only counts if no command is queued at all.
+ */
+void Channel::stall(Cycle cycles)
+{
+    uint32_t index;
+    StallCause cause = sched_.limit(index);
+    if (dispatch_stall_ == STALL_QUEUE_FULL ||
+            (cause == STALL_EMPTY && dispatch_stall_ != STALL_EMPTY)) {
+        cause = dispatch_stall_;
+        index = dispatch_bank_;
+    }
+    stats_.stall(cause, index, cycles);
+}
+
+
+/*
+ * Write the record of the epoch ending at next_epoch_, and start the next one
+ */
+void Channel::EndEpoch()
+{
+    EpochRecord record;
+    stats_.TakeEpoch(record, next_epoch_ - ctrl_cfg_->epoch, next_epoch_,
+                     ctrl_cfg_->ctrl_freq);
+    record.chan = id_;
+    trc_->epoch(record);
+    next_epoch_ += ctrl_cfg_->epoch;
 }
 
 
 /*
  * Initialize the channel by specifying:
+ *   the pools that transactions and commands are allocated from
  *   a controller configuration
  *   a device fconfiguration
  *   a set of output stream
  */
-bool Channel::init(uint16_t id, CtrlCfg *ctrl_cfg, DevCfg *dev_cfg,
-                   ofstream *log, ofstream *csv, ofstream *trc)
+bool Channel::init(uint16_t id, Pool<Transaction> *tx_pool,
+                   Pool<Command> *cmd_pool, CtrlCfg *ctrl_cfg, DevCfg *dev_cfg,
+                   ostream *log, ostream *csv, RecordSink *trc)
 {
     id_ = id;
+    tx_pool_ = tx_pool;
     bool success = MemObj::init(ctrl_cfg, dev_cfg, log, csv, trc);
 
     success &= mapper_.init(ctrl_cfg_, dev_cfg_);
-    success &= sched_.init(ctrl_cfg_, dev_cfg_, log_, csv_, trc_);
+    success &= sched_.init(cmd_pool, ctrl_cfg_, dev_cfg_, log_, csv_, trc_);
     
     if (!success) return false;
     
@@ -95,19 +170,30 @@ bool Channel::init(uint16_t id, CtrlCfg *ctrl_cfg, DevCfg *dev_cfg,
     uint32_t num_bank = dev_cfg_->num_bank;
     // resize bank state table
     banks_.resize(num_rank);
-    for (auto &b1 : banks_) {
-        b1.resize(num_bank);
-        for (auto &b2 : b1) {
-            success &= b2.init(ctrl_cfg, dev_cfg, log, csv, trc);
-            if (verbose_) b2.set_verbose();
+    rank_timings_.resize(num_rank);
+    for (uint32_t r = 0; r < num_rank; ++r) {
+        banks_[r].resize(num_bank);
+        for (auto &b : banks_[r]) {
+            success &= b.init(r, &(rank_timings_[r]), &chan_timing_,
+                              ctrl_cfg, dev_cfg, log, csv, trc);
+            if (verbose_) b.set_verbose();
         }
     }
+    stats_.init(num_rank, num_bank, ctrl_cfg_->lifecycle_sample);
+    // epochs are only of use with somewhere to write them
+    next_epoch_ = (ctrl_cfg_->epoch && trc_) ? ctrl_cfg_->epoch : MAX_CYCLE;
 
     if (!success) return false;
     
     // forward related parameters
     sched_.SetCmdQueueDepth(ctrl_cfg_->max_cmd_queue_depth);
 
+    // reserve the queues up front so they never grow during simulation
+    rd_queue_.reserve(ctrl_cfg_->max_rd_queue_depth);
+    rd_resp_queue_.reserve(ctrl_cfg_->max_rd_queue_depth);
+    wr_queue_.reserve(ctrl_cfg_->max_wr_queue_depth);
+    wr_resp_queue_.reserve(ctrl_cfg_->max_wr_queue_depth);
+
     // set verbosity
     if (verbose_) {
         sched_.set_verbose();
@@ -125,36 +211,235 @@ bool Channel::init(uint16_t id, CtrlCfg *ctrl_cfg, DevCfg *dev_cfg,
  */
 bool Channel::AddTx(Transaction *tx)
 {
+    if (!CanAccept(tx)) return false;
+    decode(tx);
+    tx->set_arrive_cycle(cycle_);
+    // sampling by ID picks the same transactions in every mode
+    uint32_t sample = ctrl_cfg_->lifecycle_sample;
+    if (sample && tx->id() % sample == 0) {
+        tx->set_sample(samples_.size());
+        samples_.push_back(Lifecycle{tx, MAX_CYCLE, MAX_CYCLE, MAX_CYCLE,
+                                     MAX_CYCLE});
+    }
     if (tx->is_read()) {
         // add to read queue
-        if (rd_queue_.size() + rd_resp_queue_.size() <
-                ctrl_cfg_->max_rd_queue_depth) {
-            rd_queue_.push_back(tx);
-            return true;
-        } else {
-            return false;
-        }
+        rd_queue_.push_back(tx);
     } else {
         // add to write queue
-        if (wr_queue_.size() + wr_resp_queue_.size() <
-                ctrl_cfg_->max_wr_queue_depth) {
-            wr_queue_.push_back(tx);
-            // turn on write draining if write buffer is full
-            wr_draining_ |= (wr_queue_.size() == ctrl_cfg_->max_wr_queue_depth);
-            return true;
-        } else {
-            return false;
+        wr_queue_.push_back(tx);
+        // turn on write draining if write buffer is full
+        wr_draining_ |= (wr_queue_.size() == ctrl_cfg_->max_wr_queue_depth);
+    }
+    return true;
+}
+
+
+/*
+ * Check if the proper queue has room for a transaction
+ */
+bool Channel::CanAccept(Transaction *tx) const
+{
+    if (tx->is_read()) {
+        return occupancy(true) < ctrl_cfg_->max_rd_queue_depth;
+    } else {
+        return occupancy(false) < ctrl_cfg_->max_wr_queue_depth;
+    }
+}
+
+
+/*
+ * Return the number of read or write transactions held by the channel
+ */
+size_t Channel::occupancy(bool is_read) const
+{
+    if (is_read) {
+        return rd_queue_.size() + rd_resp_queue_.size();
+    } else {
+        return wr_queue_.size() + wr_resp_queue_.size();
+    }
+}
+
+
+/*
+ * Hand retired transactions to a queue, which is drained by the thread that
+ *   owns the transaction pool
+ */
+void Channel::set_retire_queue(SpscQueue<Transaction *> *retire_queue)
+{
+    retire_queue_ = retire_queue;
+}
+
+
+/*
+ * Call back the owner of the memory system whenever a read or a write retires
+ */
+void Channel::set_callbacks(const TxCallback *read_done,
+                            const TxCallback *write_done)
+{
+    read_done_ = read_done;
+    write_done_ = write_done;
+}
+
+
+/*
+ * Open the row of an address as if it had been accessed, without simulating
+ *   anything
+ */
+void Channel::warm(uint64_t addr, uint32_t len)
+{
+    align(addr, len, dev_cfg_->mal);
+    uint32_t chan, rank, bank, row, col;
+    mapper_.map(addr, chan, rank, bank, row, col);
+    assert(chan == id_);
+    banks_[rank][bank].warm(row);
+}
+
+
+/*
+ * Append the open row of every bank
+ */
+void Channel::GetOpenRows(vector<uint32_t> &rows) const
+{
+    for (auto &rank : banks_) {
+        for (auto &b : rank) {
+            rows.push_back(b.state(cycle_) == ACTIVE ? b.open_row() : NO_ROW);
         }
     }
 }
 
 
 /*
- * Print some statistics of the channel
+ * Open a row in every bank, which must be idle
  */
-void Channel::stat()
+void Channel::SetOpenRows(const uint32_t *rows)
 {
-    // TODO
+    for (auto &rank : banks_) {
+        for (auto &b : rank) b.warm(*rows++);
+    }
+}
+
+
+/*
+ * Forget everything but the configuration
+ */
+void Channel::reset()
+{
+    assert(occupancy(true) == 0 && occupancy(false) == 0);
+    cycle_ = 0;
+    wr_draining_ = false;
+    dispatched_ = false;
+    dispatch_stall_ = STALL_EMPTY;
+    for (auto &rank : banks_) {
+        for (auto &b : rank) b.reset();
+    }
+    for (auto &timing : rank_timings_) timing = RankTiming();
+    chan_timing_ = ChanTiming();
+    sched_.reset();
+    samples_.clear();
+    stats_.reset(0);
+    if (next_epoch_ != MAX_CYCLE) next_epoch_ = ctrl_cfg_->epoch;
+}
+
+
+/*
+ * Start the statistics over from the current cycle, along with a full epoch
+ */
+void Channel::ResetStats()
+{
+    stats_.reset(cycle_);
+    if (next_epoch_ != MAX_CYCLE) next_epoch_ = cycle_ + ctrl_cfg_->epoch;
+}
+
+
+/*
+ * Save the channel: its flags, the bank state table, the transaction queues
+ *   and the scheduler
+ */
+void Channel::save(CheckpointWriter &out) const
+{
+    out.put(cycle_);
+    out.put(wr_draining_);
+    out.put(dispatched_);
+    for (auto &rank : banks_) {
+        for (auto &b : rank) b.save(out);
+    }
+    for (auto &timing : rank_timings_) {
+        out.put(timing.next_rd);
+        out.put(timing.next_wr);
+        out.put(timing.next_act);
+        out.put(timing.rd_turnaround);
+    }
+    out.put(chan_timing_.next_wr);
+    out.put(chan_timing_.next_pd);
+    out.put(chan_timing_.next_pu);
+    chan_timing_.other_rd.save(out);
+    chan_timing_.other_wr.save(out);
+    // response queues are saved in slot order
+    const vector<Transaction *> *queues[] = {
+        &rd_queue_, &rd_resp_queue_, &wr_queue_, &wr_resp_queue_
+    };
+    for (auto queue : queues) {
+        out.put(queue->size());
+        for (auto tx : *queue) PutTx(out, tx);
+    }
+    sched_.save(out);
+}
+
+
+/*
+ * Restore what save() wrote into a channel that has just been initialized
+ * Return false if the checkpoint is broken or its transactions do not fit
+ *   the queues
+ */
+bool Channel::restore(CheckpointReader &in)
+{
+    assert(occupancy(true) == 0 && occupancy(false) == 0);
+    cycle_ = in.get();
+    wr_draining_ = in.get();
+    dispatched_ = in.get();
+    dispatch_stall_ = STALL_EMPTY;
+    for (auto &rank : banks_) {
+        for (auto &b : rank) b.restore(in);
+    }
+    for (auto &timing : rank_timings_) {
+        timing.next_rd = in.get();
+        timing.next_wr = in.get();
+        timing.next_act = in.get();
+        timing.rd_turnaround = in.get();
+    }
+    chan_timing_.next_wr = in.get();
+    chan_timing_.next_pd = in.get();
+    chan_timing_.next_pu = in.get();
+    chan_timing_.other_rd.restore(in);
+    chan_timing_.other_wr.restore(in);
+    vector<Transaction *> *queues[] = {
+        &rd_queue_, &rd_resp_queue_, &wr_queue_, &wr_resp_queue_
+    };
+    for (auto queue : queues) {
+        size_t size = in.get();
+        for (size_t i = 0; i < size && in.good(); ++i) {
+            Transaction *tx = GetTx(in, tx_pool_);
+            if (queue == &rd_resp_queue_ || queue == &wr_resp_queue_) {
+                PushResp(*queue, tx);
+            } else {
+                queue->push_back(tx);
+            }
+        }
+    }
+    if (!in.good()) return false;
+    if (occupancy(true) > ctrl_cfg_->max_rd_queue_depth ||
+            occupancy(false) > ctrl_cfg_->max_wr_queue_depth) {
+        ERROR(in.filename() << " holds more transactions than the queues of "
+              "channel " << id_ << " can take.");
+        return false;
+    }
+    // the statistics start over from the checkpoint, in the epoch it falls in
+    stats_.reset(cycle_);
+    if (next_epoch_ != MAX_CYCLE) {
+        Cycle epoch = ctrl_cfg_->epoch;
+        next_epoch_ = (cycle_ / epoch + 1) * epoch;
+    }
+    return sched_.restore(in, rd_resp_queue_, wr_resp_queue_);
 }
 
 
@@ -166,6 +451,7 @@ void Channel::stat()
  */
 bool Channel::DispatchTransaction()
 {
+    dispatch_stall_ = STALL_EMPTY;
     // do nothing it read or write transaction is empty
     if (rd_queue_.empty() && wr_queue_.empty())
         return false;
@@ -198,56 +484,62 @@ bool Channel::DispatchRead()
     uint32_t target_row = 0;
     for (auto iter = rd_queue_.begin(); iter != rd_queue_.end(); ++iter) {
         Transaction *this_tx = *iter;
-        // map this transaction to DRAM channel, rank, bank, row, column
-        uint64_t addr = this_tx->addr();
         // TODO: only support MAL-sized transaction at this time
         assert(this_tx->len() == dev_cfg_->mal);
-        uint32_t chan, rank, bank, row, col;
-        mapper_.map(addr, chan, rank, bank, row, col);
-        // check if channel mapping is correct
-        assert(chan == id_);
         // select the target bank
-        Bank &b = banks_[rank][bank];
+        Bank &b = banks_[this_tx->rank()][this_tx->bank()];
         // find the transaciton that has the earliest issue cycle
-        Cycle this_issue_cycle = b.EarliestCycle(row, this_tx->is_read());
+        Cycle this_issue_cycle = b.EarliestCycle(this_tx->row(),
+                                                 this_tx->is_read(), cycle_);
         if (this_issue_cycle < issue_cycle) {
             issue_cycle = this_issue_cycle;
             selected = this_tx;
             selected_iter = iter;
-            target_bank = &(banks_[rank][bank]);
-            target_row = row;
+            target_bank = &b;
+            target_row = this_tx->row();
         }
     }
 
     if (selected == nullptr) {
         // nothing can be issued
+        Transaction *oldest = rd_queue_.front();
+        dispatch_stall_ = STALL_BANK_IN_USE;
+        dispatch_bank_ = oldest->rank() * dev_cfg_->num_bank + oldest->bank();
         return false;
     }
 
     assert(target_bank);
     bool success = true;
-    if (target_bank->state() == ACTIVE) {
+    RowOutcome outcome = ROW_HIT;
+    if (target_bank->state(cycle_) == ACTIVE) {
         if (target_bank->open_row() == target_row) {
             // page hit, need no ACt, need no PRE
             success = sched_.AddTx(selected, false, false);
         } else {
             // page conflict, need ACT, need PRE
             success = sched_.AddTx(selected, true, true);
+            outcome = ROW_CONFLICT;
         }
     } else {
         // page miss, need ACT, need no PRE
         success = sched_.AddTx(selected, true, false);
+        outcome = ROW_MISS;
     }
 
     if (success) {       
         // successfully scheduled this read transaction
         // move it to response queue
-        rd_resp_queue_.push_back(selected);
+        PushResp(rd_resp_queue_, selected);
         rd_queue_.erase(selected_iter);
         // mark bank in use
         target_bank->use();
+        stats_.dispatch(selected, outcome, cycle_);
+        if (selected->sampled()) FindSample(selected).dispatch = cycle_;
     } else {
         // scheduler does not have enough command queue space
+        dispatch_stall_ = STALL_QUEUE_FULL;
+        dispatch_bank_ = selected->rank() * dev_cfg_->num_bank +
+                         selected->bank();
         return false;
     }
 
@@ -275,57 +567,62 @@ bool Channel::DispatchWrite()
     uint32_t target_row = 0;
     for (auto iter = wr_queue_.begin(); iter != wr_queue_.end(); ++iter) {
         Transaction *this_tx = *iter;
-        // map this transaction to DRAM channel, rank, bank, row, column
-        uint64_t addr = this_tx->addr();
         // TODO: only support MAL-sized transaction at this time
         assert(this_tx->len() == dev_cfg_->mal);
-        uint32_t chan, rank, bank, row, col;
-        mapper_.map(addr, chan, rank, bank, row, col);
-        // check if channel mapping is correct
-        assert(chan == id_);
         // select the target bank
-        Bank &b = banks_[rank][bank];
+        Bank &b = banks_[this_tx->rank()][this_tx->bank()];
         // find the transaciton that has the earliest issue cycle
-        Cycle this_issue_cycle = b.EarliestCycle(row, this_tx->is_read());
+        Cycle this_issue_cycle = b.EarliestCycle(this_tx->row(),
+                                                 this_tx->is_read(), cycle_);
         if (this_issue_cycle < issue_cycle) {
             issue_cycle = this_issue_cycle;
             selected = this_tx;
             selected_iter = iter;
-            target_bank = &(banks_[rank][bank]);
-            target_row = row;
+            target_bank = &b;
+            target_row = this_tx->row();
         }
     }
 
     if (selected == nullptr) {
         // nothing can be issued
+        Transaction *oldest = wr_queue_.front();
+        dispatch_stall_ = STALL_BANK_IN_USE;
+        dispatch_bank_ = oldest->rank() * dev_cfg_->num_bank + oldest->bank();
         return false;
     }
 
     assert(target_bank);
     bool success = true;
-    if (target_bank->state() == ACTIVE) {
+    RowOutcome outcome = ROW_HIT;
+    if (target_bank->state(cycle_) == ACTIVE) {
         if (target_bank->open_row() == target_row) {
             // page hit, need no ACt, need no PRE
             success = sched_.AddTx(selected, false, false);
         } else {
             // page conflict, need ACT, need PRE
             success = sched_.AddTx(selected, true, true);
+            outcome = ROW_CONFLICT;
         }
     } else {
         // page miss, need ACT, need no PRE
         success = sched_.AddTx(selected, true, false);
+        outcome = ROW_MISS;
     }
 
     if (success) {
         // succesfully scheduled this write transaction
         // move it to response queue
-        wr_resp_queue_.push_back(selected);
+        PushResp(wr_resp_queue_, selected);
         wr_queue_.erase(selected_iter);
         // mark bank in use
         target_bank->use();
-        // TODO write compelete call
+        stats_.dispatch(selected, outcome, cycle_);
+        if (selected->sampled()) FindSample(selected).dispatch = cycle_;
     } else {
         // scheduler does not have enough space
+        dispatch_stall_ = STALL_QUEUE_FULL;
+        dispatch_bank_ = selected->rank() * dev_cfg_->num_bank +
+                         selected->bank();
         return false;
     }
 
@@ -345,26 +642,131 @@ void Channel::process(Command *cmd)
     Transaction *tx = cmd->tx();
     // this transaction must be in a response queue
     if (tx->is_read()) {
-        auto iter = rd_resp_queue_.begin();
-        for (; iter != rd_resp_queue_.end(); ++iter) {
-            if (*iter == tx) break;
-        }
-        // we must find something
-        assert(iter != rd_resp_queue_.end());
-        rd_resp_queue_.erase(iter);
+        PopResp(rd_resp_queue_, tx);
     } else {
-        auto iter = wr_resp_queue_.begin();
-        for (; iter != wr_resp_queue_.end(); ++iter) {
-            if (*iter == tx) break;
-        }
-        // we must find something
-        assert(iter != wr_resp_queue_.end());
-        wr_resp_queue_.erase(iter);
+        PopResp(wr_resp_queue_, tx);
     }
     // release the in-use bank
     banks_[cmd->rank()][cmd->bank()].release();
+    stats_.release(cmd->rank(), cmd->bank(), cycle_);
 
-    // TODO: notify upper level caller
+    retire(tx, cycle_);
+}
+
+
+/*
+ * Note the cycle a command of a sampled transaction is issued
+ */
+void Channel::stamp(const Command *cmd)
+{
+    Lifecycle &life = FindSample(cmd->tx());
+    switch (cmd->type()) {
+    case PRECHARGE:
+        life.pre = cycle_;
+        break;
+    case ACTIVATE:
+        life.act = cycle_;
+        break;
+    default:
+        life.col = cycle_;
+    }
+}
+
+
+/*
+ * Look a sampled transaction up among the ones in flight
+ */
+Lifecycle &Channel::FindSample(const Transaction *tx)
+{
+    assert(tx->sample() < samples_.size() &&
+           samples_[tx->sample()].tx == tx);
+    return samples_[tx->sample()];
+}
+
+
+/*
+ * Hand a retired transaction back to its owner
+ * On its own thread, the channel leaves the callbacks to the memory system,
+ *   which calls them when it takes the transaction back
+ */
+void Channel::retire(Transaction *tx, Cycle cycle)
+{
+    tx->set_finish_cycle(cycle);
+    stats_.retire(tx, cycle);
+    if (tx->sampled()) {
+        // the data burst follows the column command
+        Lifecycle &life = FindSample(tx);
+        Cycle done = life.col + dev_cfg_->BL / dev_cfg_->data_rate_ +
+                     (tx->is_read() ? dev_cfg_->RL : dev_cfg_->WL);
+        stats_.sample(life, done);
+        // the last one takes the place of the transaction
+        life = samples_.back();
+        life.tx->set_sample(tx->sample());
+        samples_.pop_back();
+        tx->set_sample(NO_SAMPLE);
+    }
+    if (trc_) {
+        TxRecord record;
+        record.arrive_cycle = tx->arrive_cycle();
+        record.finish_cycle = cycle;
+        record.tx_id = tx->id();
+        record.addr = tx->addr();
+        record.len = tx->len();
+        record.chan = id_;
+        record.is_read = tx->is_read();
+        record.priority = tx->priority();
+        trc_->retire(record);
+    }
+    if (retire_queue_) {
+        // the owner of the pool is falling behind, wait for it
+        while (!retire_queue_->push(tx)) this_thread::yield();
+    } else {
+        const TxCallback *done = tx->is_read() ? read_done_ : write_done_;
+        if (done && *done) (*done)(*tx);
+        tx_pool_->destroy(tx);
+    }
+}
+
+
+/*
+ * Decode the MAL-aligned address once, and all the later stages use the DRAM
+ *   coordinates carried by the transaction
+ */
+void Channel::decode(Transaction *tx)
+{
+    uint64_t addr = tx->addr();
+    uint32_t len = tx->len();
+    align(addr, len, dev_cfg_->mal);
+    uint32_t chan, rank, bank, row, col;
+    mapper_.map(addr, chan, rank, bank, row, col);
+    // check if channel mapping is correct
+    assert(chan == id_);
+    tx->set_coord(chan, rank, bank, row, col);
+}
+
+
+/*
+ * Append a transaction to a response queue and remember its slot
+ */
+void Channel::PushResp(vector<Transaction *> &queue, Transaction *tx)
+{
+    tx->set_slot(queue.size());
+    queue.push_back(tx);
+}
+
+
+/*
+ * Remove a transaction from a response queue in constant time
+ * The last transaction in the queue takes over the slot
+ */
+void Channel::PopResp(vector<Transaction *> &queue, Transaction *tx)
+{
+    uint32_t slot = tx->slot();
+    // we must find something
+    assert(slot < queue.size() && queue[slot] == tx);
+    queue[slot] = queue.back();
+    queue[slot]->set_slot(slot);
+    queue.pop_back();
 }
 
 }
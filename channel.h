@@ -28,12 +28,17 @@
 #define CHANNEL_H
 
 #include <vector>
+#include <functional>
 
 #include "base_obj.h"
 #include "transaction.h"
 #include "address_map.h"
 #include "bank.h"
 #include "scheduler.h"
+#include "pool.h"
+#include "spsc_queue.h"
+#include "checkpoint.h"
+#include "stats.h"
 
 namespace membles
 {
@@ -46,37 +51,86 @@ class Channel : public MemObj
     Channel();
     virtual ~Channel();
 
-    bool init(uint16_t id, CtrlCfg *ctrl_cfg, DevCfg *dev_cfg,
-              ofstream *log, ofstream *csv, ofstream *trc);
+    bool init(uint16_t id, Pool<Transaction> *tx_pool,
+              Pool<Command> *cmd_pool, CtrlCfg *ctrl_cfg, DevCfg *dev_cfg,
+              ostream *log, ostream *csv, RecordSink *trc);
 
     void step();
 
+    Cycle NextEvent() const;
+    void SkipTo(Cycle cycle);
+
     // accessors
     uint32_t id() const { return id_; }
 
     bool AddTx(Transaction *tx);
+    bool CanAccept(Transaction *tx) const;
+    size_t occupancy(bool is_read) const;
+
+    void set_retire_queue(SpscQueue<Transaction *> *retire_queue);
+    void set_callbacks(const TxCallback *read_done,
+                       const TxCallback *write_done);
+
+    const ChanStats &stats() const { return stats_; }
+    // start the statistics and the epochs over from the current cycle
+    void ResetStats();
+
+    void save(CheckpointWriter &out) const;
+    bool restore(CheckpointReader &in);
 
-    void stat();
+    // row buffer state, one row (or NO_ROW) per bank indexed by
+    //   rank * num_bank + bank
+    void warm(uint64_t addr, uint32_t len);
+    void GetOpenRows(vector<uint32_t> &rows) const;
+    void SetOpenRows(const uint32_t *rows);
+
+    // go back to cycle 0, the channel must hold no transaction
+    void reset();
 
     void process(Command *cmd);
+    // a command of a sampled transaction is issued
+    void stamp(const Command *cmd);
 
   private:
 
+    // the lifecycle of a sampled transaction in flight, by its sample index
+    Lifecycle &FindSample(const Transaction *tx);
+
+    // write the record of the epoch ending at next_epoch_
+    void EndEpoch();
+    // charge idle command bus cycles to what holds the bus up
+    void stall(Cycle cycles);
+
     // channel id
     uint32_t id_;
 
+    // transaction allocator (owned by the memory system)
+    Pool<Transaction> *tx_pool_;
+    // when the channel runs on its own thread, retired transactions are
+    //   handed back through this queue instead of the pool
+    SpscQueue<Transaction *> *retire_queue_;
+    // called when a transaction retires (owned by the memory system), only
+    //   when the channel does not run on its own thread
+    const TxCallback *read_done_;
+    const TxCallback *write_done_;
+
     // address mapper
     AddressMap mapper_;
     
     // bank state table
     vector<vector<Bank>> banks_;
 
+    // timing constraints shared by the banks of each rank and the channel
+    vector<RankTiming> rank_timings_;
+    ChanTiming chan_timing_;
+
     // memory scheduler
     Scheduler sched_;
 
     // read transaction queue
     vector<Transaction *> rd_queue_;
     // scheduled read tansacitons are moved to read response queue
+    // response queues are unordered, each transaction knows its own slot
     vector<Transaction *> rd_resp_queue_;
 
     // write transaction queue
@@ -87,11 +141,31 @@ class Channel : public MemObj
     // indicating whether the channel is in write draining state
     bool wr_draining_;
 
+    // indicating whether the last dispatch attempt succeeded
+    bool dispatched_;
+    // why the last dispatch attempt failed, STALL_EMPTY unless it did, and
+    //   the bank (rank * num_bank + bank) it failed on
+    StallCause dispatch_stall_;
+    uint32_t dispatch_bank_;
+
+    ChanStats stats_;
+    // the sampled transactions in flight, only a few at a time
+    vector<Lifecycle> samples_;
+    // the cycle the current epoch ends, MAX_CYCLE without epochs
+    Cycle next_epoch_;
+
+    void decode(Transaction *tx);
+    void retire(Transaction *tx, Cycle cycle);
+
     // dispatch transaction into scheduler
     bool DispatchTransaction();
     bool DispatchRead();
     bool DispatchWrite();
 
+    // response queue management
+    void PushResp(vector<Transaction *> &queue, Transaction *tx);
+    void PopResp(vector<Transaction *> &queue, Transaction *tx);
+
 };
 
 }
@@ -0,0 +1,265 @@
+/* Copyright (c) 2014, Jue Wang
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <chrono>
+
+#include "channel_worker.h"
+
+namespace membles
+{
+
+// a waiting thread yields this many times before going to sleep, since the
+//   other thread is usually about to get there
+static const uint32_t SPIN_LIMIT = 1000;
+
+/* ctor: Channel Worker
+ * The worker does not run until start() is called
+ */
+ChannelWorker::ChannelWorker()
+    : chan_(nullptr),
+      ctrl_cfg_(nullptr),
+      horizon_(0),
+      done_(0),
+      stopping_(false),
+      rd_bound_(0),
+      wr_bound_(0)
+{}
+
+
+/* dtor: Channel Worker
+ * Make sure the thread has exited
+ */
+ChannelWorker::~ChannelWorker()
+{
+    stop();
+}
+
+
+/*
+ * Bind the worker to a channel, whose current cycle is the first horizon
+ */
+void ChannelWorker::init(Channel *chan, CtrlCfg *ctrl_cfg)
+{
+    chan_ = chan;
+    ctrl_cfg_ = ctrl_cfg;
+    horizon_.store(chan_->cycle(), memory_order_relaxed);
+    done_.store(chan_->cycle(), memory_order_relaxed);
+    // the occupancy bound never exceeds the queue depth, so neither does the
+    //   number of transactions in flight between the threads
+    size_t depth = ctrl_cfg_->max_rd_queue_depth +
+            ctrl_cfg_->max_wr_queue_depth;
+    inputs_.init(depth);
+    retired_.init(2 * depth);
+    chan_->set_retire_queue(&retired_);
+    refresh();
+}
+
+
+/*
+ * Spawn the thread
+ */
+void ChannelWorker::start()
+{
+    assert(chan_ && !thread_.joinable());
+    stopping_ = false;
+    thread_ = thread(&ChannelWorker::run, this);
+}
+
+
+/*
+ * Let the thread reach the horizon and exit
+ */
+void ChannelWorker::stop()
+{
+    if (!thread_.joinable()) return;
+    {
+        lock_guard<mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    resume_.notify_one();
+    thread_.join();
+}
+
+
+/*
+ * Check the occupancy bound against the queue depth
+ */
+bool ChannelWorker::MightAccept(Transaction *tx) const
+{
+    if (tx->is_read()) {
+        return rd_bound_ < ctrl_cfg_->max_rd_queue_depth;
+    } else {
+        return wr_bound_ < ctrl_cfg_->max_wr_queue_depth;
+    }
+}
+
+
+/*
+ * Queue a transaction for the channel
+ * The cycle must be no earlier than the horizon, and the occupancy bound
+ *   must have been checked
+ */
+void ChannelWorker::push(Cycle cycle, Transaction *tx)
+{
+    assert(MightAccept(tx));
+    Input input = {cycle, tx};
+    bool success = inputs_.push(input);
+    assert(success);
+    (void)success;
+    if (tx->is_read()) {
+        rd_bound_++;
+    } else {
+        wr_bound_++;
+    }
+}
+
+
+/*
+ * Move the horizon on and wake the worker up
+ */
+void ChannelWorker::advance(Cycle horizon)
+{
+    if (horizon <= horizon_.load(memory_order_relaxed)) return;
+    {
+        lock_guard<mutex> lock(mutex_);
+        horizon_.store(horizon, memory_order_release);
+    }
+    resume_.notify_one();
+}
+
+
+/*
+ * Check if the channel is done with everything before a cycle
+ */
+bool ChannelWorker::CaughtUp(Cycle cycle) const
+{
+    return reached(cycle) && inputs_.empty();
+}
+
+
+/*
+ * Check if the worker stopped at or after a cycle
+ */
+bool ChannelWorker::reached(Cycle cycle) const
+{
+    return done_.load(memory_order_acquire) >= cycle;
+}
+
+
+/*
+ * Sleep until the worker reaches a cycle
+ * A worker blocked on a full retire queue never gets there, so the sleep is
+ *   cut short for the caller to reclaim and check again
+ */
+void ChannelWorker::wait(Cycle cycle)
+{
+    for (uint32_t i = 0; i < SPIN_LIMIT; ++i) {
+        if (reached(cycle)) return;
+        this_thread::yield();
+    }
+    unique_lock<mutex> lock(mutex_);
+    reached_.wait_for(lock, chrono::microseconds(100),
+                      [&] { return reached(cycle); });
+}
+
+
+/*
+ * Take the exact occupancy of the channel as the new bound
+ */
+void ChannelWorker::refresh()
+{
+    rd_bound_ = chan_->occupancy(true);
+    wr_bound_ = chan_->occupancy(false);
+}
+
+
+/*
+ * Pop a transaction retired by the channel
+ */
+Transaction *ChannelWorker::reclaim()
+{
+    Transaction *tx = nullptr;
+    if (!retired_.pop(tx)) return nullptr;
+    return tx;
+}
+
+
+/*
+ * Thread body: simulate the channel up to the horizon, over and over
+ * Transactions are added right before the step of the cycle they were
+ *   accepted in, which is exactly where the serial mode adds them
+ */
+void ChannelWorker::run()
+{
+    uint32_t spins = 0;
+    while (true) {
+        Cycle cycle = chan_->cycle();
+        const Input *input = inputs_.front();
+        while (input && input->cycle == cycle) {
+            bool success = chan_->AddTx(input->tx);
+            assert(success);
+            (void)success;
+            inputs_.pop();
+            input = inputs_.front();
+        }
+
+        Cycle horizon = horizon_.load(memory_order_acquire);
+        if (cycle >= horizon) {
+            // nothing can be simulated before the memory system moves on,
+            //   which it usually does soon, so sleep only after a while
+            unique_lock<mutex> lock(mutex_);
+            if (spins == 0) {
+                done_.store(cycle, memory_order_release);
+                reached_.notify_one();
+            }
+            if (horizon_.load(memory_order_relaxed) > cycle) continue;
+            if (stopping_) break;
+            if (spins++ < SPIN_LIMIT) {
+                lock.unlock();
+                this_thread::yield();
+            } else {
+                resume_.wait(lock, [&] {
+                    return stopping_ ||
+                           horizon_.load(memory_order_relaxed) > cycle;
+                });
+            }
+            continue;
+        }
+        spins = 0;
+
+        chan_->step();
+
+        // jump over idle cycles, but stop at the horizon and at the next
+        //   transaction, which cannot be earlier than the horizon
+        Cycle next = min(chan_->NextEvent(), horizon);
+        input = inputs_.front();
+        if (input) next = min(next, input->cycle);
+        if (next > chan_->cycle()) chan_->SkipTo(next);
+    }
+}
+
+}
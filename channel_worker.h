@@ -0,0 +1,139 @@
+/* Copyright (c) 2014, Jue Wang
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef CHANNEL_WORKER_H
+#define CHANNEL_WORKER_H
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "macro.h"
+#include "channel.h"
+#include "transaction.h"
+#include "spsc_queue.h"
+#include "output.h"
+
+namespace membles
+{
+
+/*
+ * Simulate a channel on its own thread
+ * The memory system routes transactions to the worker through a lock-free
+ *   queue, tagged with the cycle they were accepted in, and advances a
+ *   horizon: the channel may simulate every cycle before it. Since channels
+ *   share no state, each worker advances (and skips idle cycles) on its own
+ *   and sleeps once it reaches the horizon, until the horizon moves on.
+ * The memory system does not look at the channel to accept a transaction.
+ *   It keeps an upper bound of the queue occupancy instead, which only counts
+ *   retirements when it synchronizes with the worker, and the exact check is
+ *   done only when the bound says the channel might be full.
+ */
+class ChannelWorker
+{
+
+  public:
+
+    ChannelWorker();
+    ~ChannelWorker();
+
+    void init(Channel *chan, CtrlCfg *ctrl_cfg);
+
+    void start();
+    void stop();
+
+    // the following are called by the thread of the memory system
+
+    // whether the occupancy bound leaves room for a transaction
+    bool MightAccept(Transaction *tx) const;
+    // hand an accepted transaction to the channel
+    void push(Cycle cycle, Transaction *tx);
+    // let the channel simulate every cycle before a cycle, which must be no
+    //   later than any transaction pushed afterwards
+    void advance(Cycle horizon);
+    // whether the channel has simulated every cycle before a cycle and has
+    //   taken every pushed transaction, the channel stays untouched until the
+    //   horizon moves on
+    bool CaughtUp(Cycle cycle) const;
+    // sleep until the channel reaches a cycle, or for a short while so that
+    //   the caller can make room in the retire queue
+    void wait(Cycle cycle);
+    // reset the occupancy bound, only valid when caught up
+    void refresh();
+    // get back a retired transaction, return nullptr if there is none
+    Transaction *reclaim();
+
+    // records of the channel, written out at the barriers
+    RecordBuffer &records() { return records_; }
+
+  private:
+
+    // a transaction and the cycle it was accepted in
+    struct Input {
+        Cycle cycle;
+        Transaction *tx;
+    };
+
+    Channel *chan_;
+    CtrlCfg *ctrl_cfg_;
+
+    // the channel can simulate every cycle before the horizon
+    atomic<Cycle> horizon_;
+    // the worker has stopped at this cycle, which is only updated when the
+    //   worker reaches the horizon
+    atomic<Cycle> done_;
+    // set when the worker should exit once it reaches the horizon
+    bool stopping_;
+
+    // guard the horizon moves, the stops and the sleeps of both threads
+    mutex mutex_;
+    // the horizon moved on or the worker should stop
+    condition_variable resume_;
+    // the worker reached the horizon
+    condition_variable reached_;
+
+    SpscQueue<Input> inputs_;
+    SpscQueue<Transaction *> retired_;
+
+    // upper bound of read and write queue occupancy
+    size_t rd_bound_;
+    size_t wr_bound_;
+
+    RecordBuffer records_;
+
+    thread thread_;
+
+    // whether the worker has stopped at a horizon no earlier than a cycle
+    bool reached(Cycle cycle) const;
+    void run();
+
+};
+
+}
+
+#endif
@@ -0,0 +1,189 @@
+/* Copyright (c) 2014, Jue Wang
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <cstring>
+#include <iterator>
+
+#include "checkpoint.h"
+
+namespace membles
+{
+
+/*
+ * Create a checkpoint file
+ */
+bool CheckpointWriter::open(const string &filename)
+{
+    filename_ = filename;
+    file_.open(filename.c_str(),
+               ios_base::out | ios_base::trunc | ios_base::binary);
+    if (!file_.is_open()) {
+        ERROR("Cannot open file " << filename << ".");
+        return false;
+    }
+    buf_.clear();
+    return true;
+}
+
+
+/*
+ * Write the header and every value put so far
+ */
+bool CheckpointWriter::close()
+{
+    char header[8];
+    memcpy(header, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+    for (uint32_t i = 0; i < 4; ++i) {
+        header[4 + i] = (char)(CHECKPOINT_VERSION >> (8 * i));
+    }
+    file_.write(header, sizeof(header));
+    file_.write((const char *)buf_.data(), buf_.size());
+    file_.close();
+    if (file_.fail()) {
+        ERROR("Fail to write " << filename_ << ".");
+        return false;
+    }
+    return true;
+}
+
+
+/*
+ * Append a value as a varint
+ */
+void CheckpointWriter::put(uint64_t val)
+{
+    while (val >= 0x80) {
+        buf_.push_back((uint8_t)val | 0x80);
+        val >>= 7;
+    }
+    buf_.push_back((uint8_t)val);
+}
+
+
+/* ctor: Checkpoint Reader
+ * Nothing is loaded until open() is called
+ */
+CheckpointReader::CheckpointReader()
+    : pos_(0),
+      good_(true)
+{}
+
+
+/*
+ * Load a checkpoint and check its header
+ */
+bool CheckpointReader::open(const string &filename)
+{
+    INFO("Read checkpoint from <" << filename << "> ...");
+    filename_ = filename;
+    ifstream file(filename.c_str(), ios_base::in | ios_base::binary);
+    if (!file.is_open()) {
+        ERROR("Cannot open file " << filename << ".");
+        return false;
+    }
+    char header[8];
+    if (!file.read(header, sizeof(header)) ||
+            memcmp(header, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)) != 0) {
+        ERROR(filename << " is not a checkpoint.");
+        return false;
+    }
+    uint32_t version = 0;
+    for (uint32_t i = 0; i < 4; ++i) {
+        version |= (uint32_t)(uint8_t)header[4 + i] << (8 * i);
+    }
+    if (version != CHECKPOINT_VERSION) {
+        ERROR(filename << " is a version " << version << " checkpoint, "
+              "while version " << CHECKPOINT_VERSION << " is supported.");
+        return false;
+    }
+    buf_.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+    pos_ = 0;
+    good_ = true;
+    return true;
+}
+
+
+/*
+ * Decode the next varint
+ */
+uint64_t CheckpointReader::get()
+{
+    uint64_t result = 0;
+    for (uint32_t shift = 0; shift < 64 && pos_ < buf_.size(); shift += 7) {
+        uint8_t byte = buf_[pos_++];
+        result |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return result;
+    }
+    if (good_) ERROR(filename_ << " is truncated or corrupted.");
+    good_ = false;
+    pos_ = buf_.size();
+    return 0;
+}
+
+
+/*
+ * Save a transaction, except its response queue slot, which is given by
+ *   where it is saved, and its data, which the simulator never looks at
+ */
+void PutTx(CheckpointWriter &out, const Transaction *tx)
+{
+    out.put(tx->id());
+    out.put(tx->addr());
+    out.put(tx->len());
+    out.put(tx->is_read());
+    out.put(tx->priority());
+    out.put(tx->chan());
+    out.put(tx->rank());
+    out.put(tx->bank());
+    out.put(tx->row());
+    out.put(tx->col());
+    out.put(tx->arrive_cycle());
+}
+
+
+/*
+ * Allocate a transaction saved by PutTx()
+ */
+Transaction *GetTx(CheckpointReader &in, Pool<Transaction> *pool)
+{
+    uint64_t id = in.get();
+    uint64_t addr = in.get();
+    uint32_t len = in.get();
+    bool is_read = in.get();
+    Transaction *tx = pool->create(id, addr, len, is_read);
+    tx->set_priority(in.get());
+    uint32_t chan = in.get();
+    uint32_t rank = in.get();
+    uint32_t bank = in.get();
+    uint32_t row = in.get();
+    uint32_t col = in.get();
+    tx->set_coord(chan, rank, bank, row, col);
+    tx->set_arrive_cycle(in.get());
+    return tx;
+}
+
+}
@@ -0,0 +1,117 @@
+/* Copyright (c) 2014, Jue Wang
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+
+#include "macro.h"
+#include "transaction.h"
+#include "pool.h"
+
+namespace membles
+{
+
+/*
+ * Checkpoint format: magic "MBCK", version (u32, little-endian), followed by
+ *   a sequence of unsigned varints
+ * Every component writes its state with save() and reads it back in the same
+ *   order with restore(), so the checkpoint carries no field names. A
+ *   checkpoint can only be restored into a memory system of the same
+ *   geometry, but timing and queue parameters may differ, which lets many
+ *   experiments start from one warmed-up state.
+ */
+const char CHECKPOINT_MAGIC[4] = {'M', 'B', 'C', 'K'};
+const uint32_t CHECKPOINT_VERSION = 3;
+
+
+/*
+ * Collect a checkpoint in memory, which is written by close()
+ */
+class CheckpointWriter
+{
+
+  public:
+
+    bool open(const string &filename);
+    bool close();
+
+    void put(uint64_t val);
+
+  private:
+
+    ofstream file_;
+    string filename_;
+
+    vector<uint8_t> buf_;
+
+};
+
+
+/*
+ * Load a checkpoint into memory and hand out its values
+ * Reading past the end gives zeros and marks the checkpoint as bad
+ */
+class CheckpointReader
+{
+
+  public:
+
+    CheckpointReader();
+
+    bool open(const string &filename);
+
+    uint64_t get();
+
+    // whether every value read so far was in the checkpoint
+    bool good() const { return good_; }
+    // whether every value has been read
+    bool eof() const { return pos_ == buf_.size(); }
+
+    const string &filename() const { return filename_; }
+
+  private:
+
+    string filename_;
+
+    vector<uint8_t> buf_;
+    size_t pos_;
+
+    bool good_;
+
+};
+
+
+void PutTx(CheckpointWriter &out, const Transaction *tx);
+Transaction *GetTx(CheckpointReader &in, Pool<Transaction> *pool);
+
+}
+
+#endif
@@ -29,22 +29,20 @@
 namespace membles
 {
 
-uint64_t Command::count = 0;
-
 /* ctor: Command
  * Set the birth cycle and ID
  * Initialze everything else to zero
  */
-Command::Command(Cycle birth_cycle)
-    : id_(count++),
+Command::Command(uint64_t id, Cycle birth_cycle)
+    : id_(id),
       birth_cycle_(birth_cycle),
+      parent_tx_(nullptr),
+      row_(0),
+      col_(0),
       chan_(0),
       rank_(0),
       bank_(0),
-      row_(0),
-      col_(0),
-      priority_(0),
-      parent_tx_(nullptr)
+      priority_(0)
 {}
 
 
@@ -36,7 +36,7 @@ namespace membles
 /*
  * Memory bus command type
  */
-enum CmdType {
+enum CmdType : uint8_t {
     READ,
     WRITE,
     READ_AP,        // read with auto prechrage
@@ -53,12 +53,22 @@ enum CmdType {
 };
 
 
+// the largest channel, rank or bank index a command can hold, the
+//   configurations are checked against it
+const uint32_t MAX_CMD_INDEX = UINT8_MAX;
+
+
+/*
+ * A fixed-size record of a bus command
+ * Commands are allocated from a Pool, so the derived wrappers below must not
+ *   add any data members
+ */
 class Command
 {
   
   public:
 
-    Command(Cycle birth_cycle);
+    Command(uint64_t id, Cycle birth_cycle);
 
     // accessors
     uint64_t id() const { return id_; }
@@ -82,26 +92,23 @@ class Command
     // birth cycle
     Cycle birth_cycle_;
 
-    // command type
-    CmdType type_;
+    // a back pointer to its associated transaction
+    Transaction *parent_tx_;
 
     // addresses
-    uint32_t chan_;
-    uint32_t rank_;
-    uint32_t bank_;
     uint32_t row_;
     uint32_t col_;
+    // no more than MAX_CMD_INDEX
+    uint8_t chan_;
+    uint8_t rank_;
+    uint8_t bank_;
+
+    // command type
+    CmdType type_;
 
     // priority
     uint16_t priority_;
 
-    // a back pointer to its associated transaction
-    Transaction *parent_tx_;
-
-  private:
-
-    static uint64_t count;
-
 };
 
 
@@ -113,9 +120,10 @@ class ActCmd : public Command
 
   public:
 
-    ActCmd(Cycle birth_cycle, uint32_t chan, uint32_t rank, uint32_t bank,
-           uint32_t row, uint16_t priority = 0, Transaction *tx = nullptr)
-        : Command(birth_cycle)
+    ActCmd(uint64_t id, Cycle birth_cycle, uint32_t chan, uint32_t rank,
+           uint32_t bank, uint32_t row, uint16_t priority = 0,
+           Transaction *tx = nullptr)
+        : Command(id, birth_cycle)
     {
         type_ = ACTIVATE;
         chan_ = chan;
@@ -137,9 +145,9 @@ class PreCmd : public Command
 
   public:
 
-    PreCmd(Cycle birth_cycle, uint32_t chan, uint32_t rank, uint32_t bank,
-           uint16_t priority = 0, Transaction *tx = nullptr)
-        : Command(birth_cycle)
+    PreCmd(uint64_t id, Cycle birth_cycle, uint32_t chan, uint32_t rank,
+           uint32_t bank, uint16_t priority = 0, Transaction *tx = nullptr)
+        : Command(id, birth_cycle)
     {
         type_ = PRECHARGE;
         chan_ = chan;
@@ -160,10 +168,10 @@ class ReadCmd : public Command
 
   public:
 
-    ReadCmd(Cycle birth_cycle, uint32_t chan, uint32_t rank, uint32_t bank,
-            uint32_t row, uint32_t col, uint16_t priority = 0,
+    ReadCmd(uint64_t id, Cycle birth_cycle, uint32_t chan, uint32_t rank,
+            uint32_t bank, uint32_t row, uint32_t col, uint16_t priority = 0,
             Transaction *tx = nullptr, bool ap = false)
-        : Command(birth_cycle)
+        : Command(id, birth_cycle)
     {
         type_ = ap ? READ_AP : READ;
         chan_ = chan;
@@ -186,10 +194,10 @@ class WriteCmd : public Command
 
   public:
 
-    WriteCmd(Cycle birth_cycle, uint32_t chan, uint32_t rank, uint32_t bank,
-             uint32_t row, uint32_t col, uint16_t priority = 0,
+    WriteCmd(uint64_t id, Cycle birth_cycle, uint32_t chan, uint32_t rank,
+             uint32_t bank, uint32_t row, uint32_t col, uint16_t priority = 0,
              Transaction *tx = nullptr, bool ap = false)
-        : Command(birth_cycle)
+        : Command(id, birth_cycle)
     {
         type_ = ap ? WRITE_AP : WRITE;
         chan_ = chan;
@@ -236,6 +236,15 @@ bool BaseCfg::set(string param_str, string val_str)
 }
 
 
+/*
+ * Check if a parameter name is in the map
+ */
+bool BaseCfg::has(const string &param_str) const
+{
+    return conf_map_.count(to_upper(param_str)) != 0;
+}
+
+
 /*
  * Check if all the parameters have been set
  */
@@ -119,6 +119,7 @@ class BaseCfg
 
     void create(const string &param_str, void *ptr, ParamType type);
     bool set(string param_str, string val_str);
+    bool has(const string &param_str) const;
     bool AllFilled();
     bool ReadFile(const string &filename);
     void print(ofstream &out);
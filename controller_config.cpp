@@ -45,6 +45,8 @@ CtrlCfg::CtrlCfg()
     create("WRITE_TRANS_QUEUE", &max_wr_queue_depth, IntParam);
     create("CMD_QUEUE", &max_cmd_queue_depth, IntParam);
     create("ADDR_MAP", &addr_map, StringParam);
+    create("EPOCH", &epoch, IntParam);
+    create("LIFECYCLE_SAMPLE", &lifecycle_sample, IntParam);
 
     SetDefault();
 }
@@ -61,6 +63,8 @@ void CtrlCfg::SetDefault()
     set("READ_TRANS_QUEUE",     "8"     );
     set("WRITE_TRANS_QUEUE",    "8"     );
     set("CMD_QUEUE",            "16"    );
+    set("EPOCH",                "0"     );
+    set("LIFECYCLE_SAMPLE",     "0"     );
 }
 
 
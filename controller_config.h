@@ -71,6 +71,12 @@ class CtrlCfg : public BaseCfg
     // address mapping scheme patterns
     string addr_map;
 
+    // length of a statistics epoch, unit: cycle, 0 = no epochs
+    uint32_t epoch;
+
+    // sample 1 in N transactions for the latency breakdown, 0 = no sampling
+    uint32_t lifecycle_sample;
+
 };
 
 }
@@ -29,6 +29,7 @@
 #include <unistd.h>
 
 #include "device_config.h"
+#include "command.h"
 
 #define MAX_PATH 80
 
@@ -203,6 +204,11 @@ bool DevCfg::derive(uint64_t size, const CtrlCfg &ctrl_cfg)
         return false;
     }
     num_rank = size / rank_size;
+    if (num_rank > MAX_CMD_INDEX + 1 || num_bank > MAX_CMD_INDEX + 1) {
+        ERROR("A channel can have no more than " << MAX_CMD_INDEX + 1
+              << " ranks of no more than " << MAX_CMD_INDEX + 1 << " banks");
+        return false;
+    }
 
     // calculate the number of devices per rank
     if (ctrl_cfg.chan_width % width) {
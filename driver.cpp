@@ -0,0 +1,286 @@
+/* Copyright (c) 2014, Jue Wang
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "driver.h"
+
+namespace membles
+{
+
+/* ctor: Driver
+ * Replay the whole trace by default
+ */
+Driver::Driver(MemorySystem *membles, TraceReader *reader)
+    : membles_(membles),
+      reader_(reader),
+      pending_tx_(nullptr),
+      next_cycle_(0),
+      eof_(false),
+      num_records_(0),
+      num_tx_(0),
+      num_warmup_(0),
+      roi_(false),
+      in_roi_(false),
+      roi_started_(false),
+      roi_cycle_(0),
+      lockstep_(false),
+      max_cycle_(MAX_CYCLE),
+      checkpoint_cycle_(MAX_CYCLE)
+{}
+
+
+/*
+ * Save a checkpoint to a file at the beginning of a cycle
+ */
+void Driver::set_checkpoint(Cycle cycle, const string &filename)
+{
+    checkpoint_cycle_ = cycle;
+    checkpoint_filename_ = filename;
+}
+
+
+/*
+ * Replay the trace
+ * The memory system is stepped until the trace runs out and the last
+ *   transaction is accepted
+ */
+Cycle Driver::run()
+{
+    if (membles_->fast()) return RunFast();
+
+    for (Cycle cycle = membles_->cycle(); cycle < max_cycle_; ++cycle) {
+        if (cycle == checkpoint_cycle_) save();
+        // the statistics only cover the region of interest
+        if (roi_started_ && cycle == roi_cycle_) membles_->ResetStats();
+
+        if (!pending_tx_ && cycle >= next_cycle_) {
+            TraceRecord record;
+            if (!eof_ && NextTx(record)) {
+                // calculate cycle
+                // timestamp in picosecond, frequency in MHz
+                next_cycle_ = (Cycle)(record.time / 1e6 * membles_->freq());
+                if (!roi_started_ && (num_warmup_ || roi_)) {
+                    // the region begins with the arrival of its first
+                    //   transaction
+                    roi_cycle_ = max(next_cycle_, cycle);
+                    if (roi_cycle_ == cycle) membles_->ResetStats();
+                }
+                roi_started_ = true;
+                Transaction *next_tx = membles_->NewTx(record.addr,
+                                                       record.len,
+                                                       record.is_read);
+                // a transaction no channel can take is left out
+                if (next_tx) {
+                    if (record.priority) {
+                        next_tx->set_priority(record.priority);
+                    }
+                    if (cycle < next_cycle_ || !membles_->AddTx(next_tx)) {
+                        pending_tx_ = next_tx;
+                    }
+                }
+            } else {
+                eof_ = true;
+            }
+        } else if (cycle >= next_cycle_ && membles_->AddTx(pending_tx_)) {
+            pending_tx_ = nullptr;
+        }
+
+        membles_->step();
+
+        // quit when trace is fully replayed
+        if (eof_ && !pending_tx_) break;
+
+        // nothing is simulated before the region of interest even in
+        //   lockstep mode
+        if (lockstep_ && cycle + 1 >= roi_cycle_) continue;
+
+        // jump over the cycles in which neither the trace nor the memory
+        //   system has anything to do
+        Cycle next_event = membles_->NextEvent();
+        if (!pending_tx_) {
+            // the next trace record is read at next_cycle_
+            next_event = min(next_event, max(next_cycle_, cycle + 1));
+        } else if (next_cycle_ > cycle + 1) {
+            // the pending transaction is not due yet
+            next_event = min(next_event, next_cycle_);
+        } else {
+            // the pending transaction is retried once the memory system
+            //   might take it
+            next_event = min(next_event, membles_->RetryCycle(pending_tx_));
+        }
+        // the checkpoint is taken exactly at its cycle
+        if (checkpoint_cycle_ > cycle) {
+            next_event = min(next_event, checkpoint_cycle_);
+        }
+        if (next_event != MAX_CYCLE && next_event > cycle + 1) {
+            next_event = min(next_event, max_cycle_);
+            membles_->SkipTo(next_event);
+            cycle = next_event - 1;
+        }
+    }
+
+    // the replay is only done once the transactions in flight retire, so
+    //   that every transaction counts in the statistics
+    if (eof_ && !pending_tx_) membles_->drain();
+
+    if (checkpoint_cycle_ != MAX_CYCLE &&
+            checkpoint_cycle_ >= membles_->cycle()) {
+        WARN("The simulation ends before cycle " << checkpoint_cycle_
+             << ", no checkpoint is saved.");
+    }
+
+    // release remaining pending transactions
+    if (pending_tx_) {
+        membles_->FreeTx(pending_tx_);
+        pending_tx_ = nullptr;
+    }
+
+    return membles_->cycle() - roi_cycle_;
+}
+
+
+/*
+ * Replay the trace under approximate timing
+ * Like in simulation, at most one transaction is accepted per cycle, and a
+ *   transaction finding its queue full stalls the rest of the trace
+ */
+Cycle Driver::RunFast()
+{
+    // the earliest cycle the next transaction can be accepted
+    Cycle accept_cycle = membles_->cycle();
+    TraceRecord record;
+    while (NextTx(record)) {
+        // timestamp in picosecond, frequency in MHz
+        next_cycle_ = (Cycle)(record.time / 1e6 * membles_->freq());
+        if (!roi_started_ && (num_warmup_ || roi_)) {
+            roi_cycle_ = next_cycle_;
+            membles_->ResetStats();
+        }
+        roi_started_ = true;
+        Transaction *tx = membles_->NewTx(record.addr, record.len,
+                                          record.is_read);
+        if (!tx) continue;
+        if (record.priority) tx->set_priority(record.priority);
+        Cycle cycle = membles_->AcceptCycle(tx, max(next_cycle_,
+                                                    accept_cycle));
+        if (cycle >= max_cycle_) {
+            membles_->FreeTx(tx);
+            break;
+        }
+        membles_->estimate(tx, cycle);
+        accept_cycle = cycle + 1;
+    }
+    membles_->settle();
+    return membles_->cycle() - roi_cycle_;
+}
+
+
+/*
+ * Read the next transaction to simulate
+ * Transactions before the region of interest only open their rows
+ * Return false at the end of the trace or of the region
+ */
+bool Driver::NextTx(TraceRecord &record)
+{
+    while (reader_->next(record)) {
+        num_records_++;
+        if (record.marker == ROI_BEGIN) {
+            in_roi_ = true;
+            continue;
+        }
+        if (record.marker == ROI_END) {
+            // the replay ends with the region
+            if (roi_ && roi_started_) return false;
+            in_roi_ = false;
+            continue;
+        }
+        if (record.marker != NO_MARKER) continue;
+        num_tx_++;
+        if (roi_started_ ||
+                ((in_roi_ || !roi_) && num_tx_ > num_warmup_)) {
+            return true;
+        }
+        membles_->warm(record.addr, record.len);
+    }
+    return false;
+}
+
+
+/*
+ * Write the memory system and the replay position to the checkpoint file
+ */
+bool Driver::save()
+{
+    CheckpointWriter out;
+    if (!out.open(checkpoint_filename_)) return false;
+    membles_->save(out);
+    out.put(pending_tx_ != nullptr);
+    if (pending_tx_) membles_->SaveTx(out, pending_tx_);
+    out.put(next_cycle_);
+    out.put(eof_);
+    out.put(num_records_);
+    out.put(num_tx_);
+    out.put(in_roi_);
+    out.put(roi_started_);
+    out.put(roi_cycle_);
+    if (!out.close()) return false;
+    INFO("Checkpoint of cycle " << membles_->cycle() << " saved to <"
+         << checkpoint_filename_ << ">.");
+    return true;
+}
+
+
+/*
+ * Load a checkpoint into the memory system, which has just been initialized,
+ *   and move the trace to where the checkpoint was taken
+ */
+bool Driver::restore(const string &filename)
+{
+    CheckpointReader in;
+    if (!in.open(filename)) return false;
+    if (!membles_->restore(in)) return false;
+    if (in.get()) pending_tx_ = membles_->RestoreTx(in);
+    next_cycle_ = in.get();
+    eof_ = in.get();
+    num_records_ = in.get();
+    num_tx_ = in.get();
+    in_roi_ = in.get();
+    roi_started_ = in.get();
+    roi_cycle_ = in.get();
+    if (!in.good()) return false;
+    if (!in.eof()) {
+        ERROR(filename << " has unknown data at its end.");
+        return false;
+    }
+    if (reader_->skip(num_records_) != num_records_) {
+        ERROR("The trace is shorter than the one " << filename
+              << " is taken from.");
+        return false;
+    }
+    return true;
+}
+
+}
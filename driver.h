@@ -0,0 +1,121 @@
+/* Copyright (c) 2014, Jue Wang
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef DRIVER_H
+#define DRIVER_H
+
+#include "macro.h"
+#include "memory_system.h"
+#include "trace.h"
+#include "checkpoint.h"
+
+namespace membles
+{
+
+/*
+ * Replay a trace into a memory system
+ * A transaction is offered to the memory system once its arrival cycle is
+ *   reached, and it is retried until accepted, which stalls the rest of the
+ *   trace
+ * Only the transactions in the region of interest are simulated in detail.
+ *   The region starts after a number of warmup transactions, and if markers
+ *   are honored, it is further limited to the transactions between the
+ *   ROI_BEGIN and ROI_END markers of the trace. Transactions before the region
+ *   only open their rows, so the region does not start with cold row buffers,
+ *   and the replay ends with the region.
+ * In fast mode the memory system is never stepped, and the transactions are
+ *   retired under approximate timing instead, see FastChannel::estimate()
+ * A checkpoint holds the memory system, the transaction waiting to be
+ *   accepted and the number of trace records read so far, so a replay can be
+ *   resumed from it with the same trace
+ */
+class Driver
+{
+
+  public:
+
+    Driver(MemorySystem *membles, TraceReader *reader);
+
+    // replay the trace to its end, return the cycles elapsed since the
+    //   region of interest begins
+    Cycle run();
+
+    void set_lockstep() { lockstep_ = true; }
+    void set_max_cycle(Cycle max_cycle) { max_cycle_ = max_cycle; }
+    void set_warmup(uint64_t num_warmup) { num_warmup_ = num_warmup; }
+    void set_roi() { roi_ = true; }
+    // cycle the region of interest begins at, valid once run() returns
+    Cycle roi_cycle() const { return roi_cycle_; }
+    // save a checkpoint once a cycle is reached
+    void set_checkpoint(Cycle cycle, const string &filename);
+
+    // resume from a checkpoint, must be called before run()
+    bool restore(const string &filename);
+
+  private:
+
+    MemorySystem *membles_;
+    TraceReader *reader_;
+
+    // the transaction waiting for its arrival cycle or for room
+    Transaction *pending_tx_;
+    // arrival cycle of the last trace record
+    Cycle next_cycle_;
+    bool eof_;
+    // number of trace records read so far
+    uint64_t num_records_;
+    // number of transactions read so far
+    uint64_t num_tx_;
+
+    // number of transactions before the region of interest
+    uint64_t num_warmup_;
+    // honor the markers of the trace
+    bool roi_;
+    // inside the ROI_BEGIN and ROI_END markers
+    bool in_roi_;
+    // the first transaction of the region has been read
+    bool roi_started_;
+    Cycle roi_cycle_;
+
+    // simulate every cycle instead of skipping idle cycles
+    bool lockstep_;
+
+    // stop at this cycle even if the trace is not fully replayed
+    Cycle max_cycle_;
+
+    Cycle checkpoint_cycle_;
+    string checkpoint_filename_;
+
+    bool save();
+    bool NextTx(TraceRecord &record);
+    Cycle RunFast();
+
+};
+
+}
+
+#endif
@@ -0,0 +1,510 @@
+/* Copyright (c) 2014, Jue Wang
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <algorithm>
+
+#include "fast_channel.h"
+
+namespace membles
+{
+
+/* ctor: Fast Channel
+ * Nothing can be estimated until init() is called
+ */
+FastChannel::FastChannel()
+    : id_(0),
+      ctrl_cfg_(nullptr),
+      dev_cfg_(nullptr),
+      trc_(nullptr),
+      cycle_(0),
+      tx_pool_(nullptr),
+      read_done_(nullptr),
+      write_done_(nullptr),
+      rd_taken_(0),
+      wr_taken_(0),
+      drain_until_(0)
+{}
+
+
+/*
+ * Initialize the channel by specifying:
+ *   the pool that transactions are allocated from
+ *   a controller configuration
+ *   a device configuration
+ *   where the records go
+ */
+bool FastChannel::init(uint16_t id, Pool<Transaction> *tx_pool,
+                       CtrlCfg *ctrl_cfg, DevCfg *dev_cfg, RecordSink *trc)
+{
+    id_ = id;
+    tx_pool_ = tx_pool;
+    ctrl_cfg_ = ctrl_cfg;
+    dev_cfg_ = dev_cfg;
+    trc_ = trc;
+    if (!mapper_.init(ctrl_cfg_, dev_cfg_)) return false;
+
+    uint32_t num_rank = dev_cfg_->num_rank;
+    uint32_t num_bank = dev_cfg_->num_bank;
+    stats_.init(num_rank, num_bank, ctrl_cfg_->lifecycle_sample);
+    banks_.assign(num_rank * num_bank, FastBank{NO_ROW, 0, 0, 0});
+    acts_.assign(num_rank, deque<Cycle>());
+    FastTiming &ft = timing_;
+    ft.tRP = dev_cfg_->tRP();
+    ft.tRAS = dev_cfg_->tRAS();
+    ft.tRC = dev_cfg_->tRC();
+    ft.tRRD = dev_cfg_->tRRD();
+    ft.act_to_col = dev_cfg_->tRCD() - dev_cfg_->AL;
+    ft.rd_to_pre = dev_cfg_->RdToPre();
+    ft.wr_to_pre = dev_cfg_->WrToPre();
+    ft.col_to_col = dev_cfg_->tCCD();
+    ft.col_to_other_col = dev_cfg_->BL / dev_cfg_->data_rate_ + 1;
+    ft.rd_to_wr = dev_cfg_->RdToWr();
+    ft.wr_to_rd = dev_cfg_->WrToRd(true);
+    ft.wr_to_other_rd = dev_cfg_->WrToRd(false);
+    ft.max_col_gap = max(max(ft.col_to_col, ft.col_to_other_col),
+                         max(ft.rd_to_wr,
+                             max(ft.wr_to_rd, ft.wr_to_other_rd)));
+    return true;
+}
+
+
+/*
+ * Set the functions called when a transaction retires
+ */
+void FastChannel::set_callbacks(const TxCallback *read_done,
+                                const TxCallback *write_done)
+{
+    read_done_ = read_done;
+    write_done_ = write_done;
+}
+
+
+/*
+ * Open the row of an address as if it had been accessed
+ */
+void FastChannel::warm(uint64_t addr, uint32_t len)
+{
+    align(addr, len, dev_cfg_->mal);
+    uint32_t chan, rank, bank, row, col;
+    mapper_.map(addr, chan, rank, bank, row, col);
+    assert(chan == id_);
+    banks_[rank * dev_cfg_->num_bank + bank].row = row;
+}
+
+
+/*
+ * Append the open row of every bank
+ */
+void FastChannel::GetOpenRows(vector<uint32_t> &rows) const
+{
+    for (auto &fb : banks_) rows.push_back(fb.row);
+}
+
+
+/*
+ * Open a row in every bank
+ */
+void FastChannel::SetOpenRows(const uint32_t *rows)
+{
+    for (auto &fb : banks_) fb.row = *rows++;
+}
+
+
+/*
+ * Forget everything but the configuration
+ */
+void FastChannel::reset()
+{
+    cycle_ = 0;
+    for (auto &fb : banks_) fb = FastBank{NO_ROW, 0, 0, 0};
+    for (auto &acts : acts_) acts.clear();
+    cols_.clear();
+    rd_slots_ = decltype(rd_slots_)();
+    wr_slots_ = decltype(wr_slots_)();
+    rds_.clear();
+    wrs_.clear();
+    rd_taken_ = 0;
+    wr_taken_ = 0;
+    drain_until_ = 0;
+    stats_.reset(0);
+}
+
+
+/*
+ * Return the earliest cycle from now on that a transaction finds a free slot
+ *   in its queue
+ * A transaction holds its slot from its acceptance until the cycle after its
+ *   last column command.
+ */
+Cycle FastChannel::AcceptCycle(bool is_read, Cycle now)
+{
+    auto &slots = is_read ? rd_slots_ : wr_slots_;
+    size_t depth = is_read ? ctrl_cfg_->max_rd_queue_depth :
+                             ctrl_cfg_->max_wr_queue_depth;
+    while (true) {
+        advance(now);
+        while (!slots.empty() && slots.top() < now) slots.pop();
+        size_t waiting = is_read ? rds_.size() : wrs_.size();
+        if (slots.size() + waiting < depth) return now;
+        // the queue is full until a transaction retires, which takes a read
+        //   to take its bank first
+        Cycle next = slots.empty() ? MAX_CYCLE : slots.top() + 1;
+        if (is_read) {
+            for (auto rd : rds_) {
+                next = min(next, TakeCycle(rd, rd->arrive_cycle()));
+            }
+        }
+        now = max(now + 1, next);
+    }
+}
+
+
+/*
+ * Take a transaction accepted at cycle now, which must have a free slot by
+ *   AcceptCycle()
+ * Reads wait until their banks take them, see advance(). Writes wait until
+ *   the write queue fills up, or until the reads run out, and are then
+ *   drained together, which holds the reads back like write draining in
+ *   simulation does.
+ */
+void FastChannel::estimate(Transaction *tx, Cycle now)
+{
+    decode(tx);
+    tx->set_arrive_cycle(now);
+
+    // the commands reserved long before the oldest waiting transaction are
+    //   settled for good, nothing from now on is served earlier
+    Cycle oldest = now;
+    for (auto rd : rds_) oldest = min(oldest, rd->arrive_cycle());
+    for (auto wr : wrs_) oldest = min(oldest, wr->arrive_cycle());
+    while (!cols_.empty() &&
+           cols_.front().cycle + timing_.max_col_gap <= oldest) {
+        cols_.pop_front();
+    }
+    for (auto &acts : acts_) {
+        while (!acts.empty() && acts.front() + timing_.tRRD <= oldest) {
+            acts.pop_front();
+        }
+    }
+
+    advance(now);
+    if (tx->is_read()) {
+        rds_.push_back(tx);
+    } else if (now < drain_until_) {
+        // write draining goes on while the write queue is not empty
+        wrs_.push_back(tx);
+        drain(now);
+    } else if (rds_.empty() && wrs_.empty()) {
+        // no read is waiting
+        serve(tx, TakeCycle(tx, now));
+    } else {
+        wrs_.push_back(tx);
+        if (wrs_.size() == ctrl_cfg_->max_wr_queue_depth) drain(now);
+    }
+}
+
+
+/*
+ * Serve the remaining transactions
+ */
+void FastChannel::settle()
+{
+    advance(MAX_CYCLE);
+    if (!wrs_.empty()) drain(rd_taken_);
+}
+
+
+/*
+ * Let the banks take the waiting reads until a cycle
+ * Like FR-FCFS, the read whose bank is free first goes first, a row hit
+ *   before the others and the oldest one before the younger ones. Once the
+ *   reads run out, the waiting writes are drained.
+ */
+void FastChannel::advance(Cycle until)
+{
+    while (!rds_.empty()) {
+        size_t selected = 0;
+        Cycle take = MAX_CYCLE;
+        bool hit = false;
+        for (size_t i = 0; i < rds_.size(); ++i) {
+            Transaction *tx = rds_[i];
+            Cycle this_take = TakeCycle(tx, tx->arrive_cycle());
+            bool this_hit = (tx->row() == BankOf(tx).row);
+            if (this_take < take || (this_take == take && this_hit && !hit)) {
+                selected = i;
+                take = this_take;
+                hit = this_hit;
+            }
+        }
+        if (take > until) break;
+        Transaction *tx = rds_[selected];
+        rds_.erase(rds_.begin() + selected);
+        serve(tx, take);
+        if (rds_.empty() && !wrs_.empty()) drain(take);
+    }
+}
+
+
+/*
+ * Serve the waiting writes from a cycle on
+ * Writes to the same row go one after another in the order of the first of
+ *   them, which stands in for the row hits FR-FCFS picks first.
+ */
+void FastChannel::drain(Cycle now)
+{
+    vector<pair<size_t, Transaction *>> order;
+    order.reserve(wrs_.size());
+    for (size_t i = 0; i < wrs_.size(); ++i) {
+        Transaction *tx = wrs_[i];
+        size_t first = 0;
+        while (wrs_[first]->rank() != tx->rank() ||
+               wrs_[first]->bank() != tx->bank() ||
+               wrs_[first]->row() != tx->row()) first++;
+        order.push_back(make_pair(first, tx));
+    }
+    stable_sort(order.begin(), order.end(),
+                [](const pair<size_t, Transaction *> &a,
+                   const pair<size_t, Transaction *> &b) {
+                    return a.first < b.first;
+                });
+    wrs_.clear();
+    for (auto &w : order) {
+        Transaction *tx = w.second;
+        Cycle take = TakeCycle(tx, max(now, tx->arrive_cycle()));
+        serve(tx, take);
+        drain_until_ = max(drain_until_, take);
+    }
+}
+
+
+/*
+ * Return the cycle the bank of a transaction can take it, from the cycle
+ *   after now on
+ * Reads also wait for the writes being drained.
+ */
+Cycle FastChannel::TakeCycle(Transaction *tx, Cycle now)
+{
+    Cycle take = max(now + 1, BankOf(tx).free);
+    if (tx->is_read()) take = max(take, drain_until_ + 1);
+    return take;
+}
+
+
+/*
+ * Serve a transaction its bank takes at cycle start, and retire it right
+ *   away
+ * Return the cycle of its last column command.
+ * The commands go out as early as the timing of the bank allows:
+ *   row hit:       column commands
+ *   page miss:     ACTIVATE, then column commands tRCD later
+ *   page conflict: PRECHARGE, then ACTIVATE tRP later, then column commands
+ *   Column commands reserve a place on the bus, which may fall between the
+ *   ones reserved earlier. That stands in for FR-FCFS, which lets a later
+ *   transaction to another bank go ahead.
+ * A transaction longer than MAL stays in the row of its first MAL.
+ */
+Cycle FastChannel::serve(Transaction *tx, Cycle start)
+{
+    bool is_read = tx->is_read();
+    uint32_t rank = tx->rank();
+    uint32_t row = tx->row();
+    FastBank &fb = BankOf(tx);
+    const FastTiming &ft = timing_;
+
+    RowOutcome outcome = ROW_HIT;
+    if (fb.row != row) outcome = (fb.row == NO_ROW) ? ROW_MISS : ROW_CONFLICT;
+    stats_.dispatch(tx, outcome, start);
+
+    Cycle col = start;
+    if (fb.row != row) {
+        Cycle act = start;
+        if (fb.row != NO_ROW) {
+            Cycle pre = max(start, fb.next_pre);
+            LogCommand(PRECHARGE, tx, pre);
+            act = max(act, pre + ft.tRP);
+        }
+        act = ReserveAct(max(act, fb.next_act), rank);
+        LogCommand(ACTIVATE, tx, act);
+        fb.row = row;
+        fb.next_pre = act + ft.tRAS;
+        fb.next_act = act + ft.tRC;
+        col = act + ft.act_to_col;
+    }
+
+    // one column command per MAL
+    uint64_t addr = tx->addr();
+    uint32_t len = tx->len();
+    align(addr, len, dev_cfg_->mal);
+    CmdType type = is_read ? READ : WRITE;
+    for (uint32_t i = 0; i < len / dev_cfg_->mal; ++i) {
+        if (i) col++;
+        col = reserve(col, rank, is_read);
+        LogCommand(type, tx, col);
+    }
+
+    fb.next_pre = max(fb.next_pre, col + (is_read ? ft.rd_to_pre :
+                                                    ft.wr_to_pre));
+    fb.next_act = max(fb.next_act, fb.next_pre + ft.tRP);
+    fb.free = col + 1;
+    stats_.release(rank, tx->bank(), col);
+    Cycle &taken = is_read ? rd_taken_ : wr_taken_;
+    taken = max(taken, start);
+    (is_read ? rd_slots_ : wr_slots_).push(col);
+    cycle_ = max(cycle_, col + 1);
+    retire(tx, col);
+    return col;
+}
+
+/*
+ * Decode the MAL-aligned address once, and all the later stages use the DRAM
+ *   coordinates carried by the transaction
+ */
+void FastChannel::decode(Transaction *tx)
+{
+    uint64_t addr = tx->addr();
+    uint32_t len = tx->len();
+    align(addr, len, dev_cfg_->mal);
+    uint32_t chan, rank, bank, row, col;
+    mapper_.map(addr, chan, rank, bank, row, col);
+    // check if channel mapping is correct
+    assert(chan == id_);
+    tx->set_coord(chan, rank, bank, row, col);
+}
+
+
+/*
+ * Hand a retired transaction back to its owner
+ */
+void FastChannel::retire(Transaction *tx, Cycle cycle)
+{
+    tx->set_finish_cycle(cycle);
+    stats_.retire(tx, cycle);
+    if (trc_) {
+        TxRecord record;
+        record.arrive_cycle = tx->arrive_cycle();
+        record.finish_cycle = cycle;
+        record.tx_id = tx->id();
+        record.addr = tx->addr();
+        record.len = tx->len();
+        record.chan = id_;
+        record.is_read = tx->is_read();
+        record.priority = tx->priority();
+        trc_->retire(record);
+    }
+    const TxCallback *done = tx->is_read() ? read_done_ : write_done_;
+    if (done && *done) (*done)(*tx);
+    tx_pool_->destroy(tx);
+}
+
+
+/*
+ * Return the distance from a column command on the bus to a later one of a
+ *   rank, like the bank timing enforces in simulation
+ */
+Cycle FastChannel::ColGap(const FastCol &first, uint32_t rank,
+                          bool is_read) const
+{
+    bool same_rank = (first.rank == rank);
+    if (first.is_read == is_read) {
+        return same_rank ? timing_.col_to_col :
+                           timing_.col_to_other_col;
+    }
+    if (first.is_read) return timing_.rd_to_wr;
+    return same_rank ? timing_.wr_to_rd : timing_.wr_to_other_rd;
+}
+
+
+/*
+ * Reserve the earliest place on the bus from a cycle for a column command of
+ *   a rank, and return its cycle
+ * Every reserved command keeps its distance to the commands before and after
+ *   it. Commands further apart than any gap never conflict.
+ */
+Cycle FastChannel::reserve(Cycle cycle, uint32_t rank, bool is_read)
+{
+    FastCol col{cycle, rank, is_read};
+    Cycle max_gap = timing_.max_col_gap;
+    auto it = lower_bound(cols_.begin(), cols_.end(), col,
+                          [max_gap](const FastCol &a, const FastCol &b) {
+                              return a.cycle + max_gap <= b.cycle;
+                          });
+    for (; it != cols_.end(); ++it) {
+        if (it->cycle <= col.cycle) {
+            col.cycle = max(col.cycle, it->cycle + ColGap(*it, rank, is_read));
+        } else if (col.cycle + ColGap(col, it->rank, it->is_read) >
+                   it->cycle) {
+            // too close to the next one, try after it
+            col.cycle = it->cycle + ColGap(*it, rank, is_read);
+        } else {
+            break;
+        }
+    }
+    cols_.insert(it, col);
+    return col.cycle;
+}
+
+
+/*
+ * Reserve the earliest activation of a rank from a cycle, which keeps tRRD
+ *   to the activations before and after it, and return its cycle
+ */
+Cycle FastChannel::ReserveAct(Cycle cycle, uint32_t rank)
+{
+    deque<Cycle> &acts = acts_[rank];
+    Cycle gap = timing_.tRRD;
+    auto it = lower_bound(acts.begin(), acts.end(), cycle,
+                          [gap](Cycle a, Cycle b) { return a + gap <= b; });
+    for (; it != acts.end() && cycle + gap > *it; ++it) {
+        // too close to this one, try after it
+        cycle = *it + gap;
+    }
+    acts.insert(it, cycle);
+    return cycle;
+}
+
+
+/*
+ * Count and record a reserved command, which is never created
+ */
+void FastChannel::LogCommand(CmdType type, Transaction *tx, Cycle cycle)
+{
+    stats_.issue();
+    if (!trc_) return;
+    CmdRecord record;
+    record.cycle = cycle;
+    record.tx_id = tx->id();
+    record.row = tx->row();
+    record.col = tx->col();
+    record.chan = id_;
+    record.rank = tx->rank();
+    record.bank = tx->bank();
+    record.type = type;
+    record.reserved = 0;
+    trc_->command(record);
+}
+
+}
@@ -0,0 +1,196 @@
+/* Copyright (c) 2014, Jue Wang
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef FAST_CHANNEL_H
+#define FAST_CHANNEL_H
+
+#include <vector>
+#include <queue>
+#include <deque>
+
+#include "macro.h"
+#include "controller_config.h"
+#include "device_config.h"
+#include "transaction.h"
+#include "address_map.h"
+#include "bank.h"
+#include "command.h"
+#include "pool.h"
+#include "output.h"
+#include "stats.h"
+
+namespace membles
+{
+
+/*
+ * Approximate the timing of a channel without simulating it
+ * No scheduler runs and no command is created: every transaction is served
+ *   as soon as it is accepted, by reserving its commands against the bank
+ *   timing and the command bus, and is retired right away. The channel is
+ *   never stepped, its cycle is the one after the last retirement.
+ */
+class FastChannel
+{
+
+  public:
+
+    FastChannel();
+
+    bool init(uint16_t id, Pool<Transaction> *tx_pool, CtrlCfg *ctrl_cfg,
+              DevCfg *dev_cfg, RecordSink *trc);
+
+    // accessors
+    uint32_t id() const { return id_; }
+    Cycle cycle() const { return cycle_; }
+
+    void set_callbacks(const TxCallback *read_done,
+                       const TxCallback *write_done);
+
+    const ChanStats &stats() const { return stats_; }
+    // start the statistics over from the current cycle
+    void ResetStats() { stats_.reset(cycle_); }
+
+    // row buffer state, one row (or NO_ROW) per bank indexed by
+    //   rank * num_bank + bank
+    void warm(uint64_t addr, uint32_t len);
+    void GetOpenRows(vector<uint32_t> &rows) const;
+    void SetOpenRows(const uint32_t *rows);
+
+    // go back to cycle 0, the channel must hold no transaction
+    void reset();
+
+    // the earliest cycle from now on that a transaction finds room
+    Cycle AcceptCycle(bool is_read, Cycle now);
+    // take a transaction at cycle now, see estimate()
+    void estimate(Transaction *tx, Cycle now);
+    // serve the remaining transactions
+    void settle();
+
+  private:
+
+    // the state of every bank, indexed by rank * num_bank + bank
+    struct FastBank {
+        // open row, NO_ROW if closed
+        uint32_t row;
+        // the cycle the bank takes its next transaction
+        Cycle free;
+        // the earliest cycles of the next commands
+        Cycle next_act;
+        Cycle next_pre;
+    };
+
+    // a column command reserved on the bus
+    struct FastCol {
+        Cycle cycle;
+        uint32_t rank;
+        bool is_read;
+    };
+
+    // the timing parameters in cycles, looked up once
+    struct FastTiming {
+        Cycle tRP;
+        Cycle tRAS;
+        Cycle tRC;
+        Cycle tRRD;
+        // ACTIVATE to column command
+        Cycle act_to_col;
+        Cycle rd_to_pre;
+        Cycle wr_to_pre;
+        // between column commands of the same rank and of different ranks
+        Cycle col_to_col;
+        Cycle col_to_other_col;
+        Cycle rd_to_wr;
+        Cycle wr_to_rd;
+        Cycle wr_to_other_rd;
+        // the longest distance between column commands
+        Cycle max_col_gap;
+    };
+
+    // channel id
+    uint32_t id_;
+
+    // configurations (owned by the memory system)
+    CtrlCfg *ctrl_cfg_;
+    DevCfg *dev_cfg_;
+    // command and transaction records
+    RecordSink *trc_;
+    // the cycle after the last retirement
+    Cycle cycle_;
+
+    // transaction allocator (owned by the memory system)
+    Pool<Transaction> *tx_pool_;
+    // called when a transaction retires (owned by the memory system)
+    const TxCallback *read_done_;
+    const TxCallback *write_done_;
+
+    // address mapper
+    AddressMap mapper_;
+
+    ChanStats stats_;
+
+    vector<FastBank> banks_;
+    // the activations reserved so far in every rank, in cycle order, which
+    //   keep their distance by tRRD
+    vector<deque<Cycle>> acts_;
+    // the column commands reserved so far, in cycle order, which keep their
+    //   distance by tCCD and the turnarounds
+    deque<FastCol> cols_;
+    FastTiming timing_;
+    // the retire cycles of the transactions holding a slot of the read or
+    //   the write queue
+    priority_queue<Cycle, vector<Cycle>, greater<Cycle>> rd_slots_;
+    priority_queue<Cycle, vector<Cycle>, greater<Cycle>> wr_slots_;
+    // the reads waiting for their banks, and the writes waiting to be
+    //   drained together
+    vector<Transaction *> rds_;
+    vector<Transaction *> wrs_;
+    // the cycles the last read and the last write took their banks
+    Cycle rd_taken_;
+    Cycle wr_taken_;
+    // the cycle the last write being drained took its bank, which holds the
+    //   reads back
+    Cycle drain_until_;
+
+    void decode(Transaction *tx);
+    void retire(Transaction *tx, Cycle cycle);
+    Cycle ColGap(const FastCol &first, uint32_t rank, bool is_read) const;
+    Cycle reserve(Cycle cycle, uint32_t rank, bool is_read);
+    Cycle ReserveAct(Cycle cycle, uint32_t rank);
+    FastBank &BankOf(Transaction *tx) {
+        return banks_[tx->rank() * dev_cfg_->num_bank + tx->bank()];
+    }
+    Cycle TakeCycle(Transaction *tx, Cycle now);
+    void advance(Cycle until);
+    void drain(Cycle now);
+    Cycle serve(Transaction *tx, Cycle start);
+    void LogCommand(CmdType type, Transaction *tx, Cycle cycle);
+
+};
+
+}
+
+#endif
@@ -0,0 +1,237 @@
+/* Copyright (c) 2014, Jue Wang
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <thread>
+
+#include "frontend.h"
+
+namespace membles
+{
+
+/* ctor: Frontend
+ * Nothing can be submitted until init() is called
+ */
+Frontend::Frontend(MemorySystem *membles)
+    : membles_(membles),
+      retry_cycle_(0)
+{}
+
+
+/* dtor: Frontend
+ * Give the transactions never accepted back, and unregister the callbacks
+ */
+Frontend::~Frontend()
+{
+    for (auto tx : pending_) membles_->FreeTx(tx);
+    membles_->RegisterCallbacks(TxCallback(), TxCallback());
+    for (auto producer : producers_) delete producer;
+}
+
+
+/*
+ * Create the queues of every producer, each of them holding up to depth
+ *   requests and depth completions
+ */
+void Frontend::init(uint32_t num_producer, size_t depth)
+{
+    assert(producers_.empty() && num_producer > 0);
+    producers_.resize(num_producer);
+    for (auto &producer : producers_) {
+        producer = new Producer;
+        producer->requests.init(depth);
+        producer->completions.init(depth);
+        producer->clock.store(0, memory_order_relaxed);
+    }
+    TxCallback done = [this](const Transaction &tx) { retire(tx); };
+    membles_->RegisterCallbacks(done, done);
+}
+
+
+/*
+ * Queue a request of producer i, which is due at a cycle
+ * The clock of the producer moves to the cycle. A request no channel could
+ *   take is refused for good.
+ */
+bool Frontend::submit(uint32_t i, Cycle cycle, uint64_t addr, uint32_t len,
+                      bool is_read, void *data)
+{
+    Producer *producer = producers_[i];
+    assert(cycle >= producer->clock.load(memory_order_relaxed));
+    if (len > membles_->max_len()) {
+        ERROR("Producer " << i << " submits a request of " << len
+              << " bytes, longer than the channel interleaving granularity");
+        return false;
+    }
+    Request request = {cycle, addr, len, is_read, data};
+    if (!producer->requests.push(request)) return false;
+    producer->clock.store(cycle, memory_order_release);
+    return true;
+}
+
+
+/*
+ * Move the clock of producer i to a cycle
+ */
+void Frontend::advance(uint32_t i, Cycle cycle)
+{
+    Producer *producer = producers_[i];
+    assert(cycle >= producer->clock.load(memory_order_relaxed));
+    producer->clock.store(cycle, memory_order_release);
+}
+
+
+/*
+ * Stop the clock of producer i for good
+ */
+void Frontend::finish(uint32_t i)
+{
+    producers_[i]->clock.store(MAX_CYCLE, memory_order_release);
+}
+
+
+/*
+ * Take the oldest completion of producer i
+ */
+bool Frontend::complete(uint32_t i, Completion &done)
+{
+    return producers_[i]->completions.pop(done);
+}
+
+
+/*
+ * Simulate one cycle, then jump to the next cycle that a request is due at,
+ *   the rejected transactions are worth retrying at, or the memory system
+ *   has something to do
+ */
+bool Frontend::step()
+{
+    if (done()) return false;
+
+    // wait for every producer to pass the cycle, taking its requests due
+    //   meanwhile, since a producer cannot pass the cycle while its queue is
+    //   full of them
+    Cycle cycle = membles_->cycle();
+    bool admitted = false;
+    for (uint32_t i = 0; i < producers_.size(); ++i) {
+        while (producers_[i]->clock.load(memory_order_acquire) <= cycle) {
+            if (admit(i, cycle)) {
+                admitted = true;
+            } else {
+                this_thread::yield();
+            }
+        }
+        if (admit(i, cycle)) admitted = true;
+    }
+
+    if (admitted || (!pending_.empty() && cycle >= retry_cycle_)) {
+        retry_cycle_ = membles_->AddTxs(pending_);
+    }
+    membles_->step();
+    deliver();
+
+    Cycle next = membles_->NextEvent();
+    if (!pending_.empty()) next = min(next, retry_cycle_);
+    for (auto producer : producers_) {
+        // the clock is read first, any request queued afterwards is due no
+        //   earlier than it
+        Cycle clock = producer->clock.load(memory_order_acquire);
+        const Request *request = producer->requests.front();
+        next = min(next, request ? request->cycle : clock);
+    }
+    if (next != MAX_CYCLE && next > membles_->cycle()) membles_->SkipTo(next);
+    return true;
+}
+
+
+/*
+ * Turn the requests of producer i due at a cycle into transactions
+ * Return true if any request is admitted
+ */
+bool Frontend::admit(uint32_t i, Cycle cycle)
+{
+    bool admitted = false;
+    SpscQueue<Request> &requests = producers_[i]->requests;
+    for (const Request *request = requests.front();
+         request && request->cycle <= cycle; request = requests.front()) {
+        Ticket *ticket = tickets_.create(i, request->data);
+        pending_.push_back(membles_->NewTx(request->addr, request->len,
+                                           request->is_read, ticket));
+        requests.pop();
+        admitted = true;
+    }
+    return admitted;
+}
+
+
+/*
+ * Hand a retired transaction back to its producer
+ * A full completion queue does not hold the simulation up, the completion
+ *   waits in the overflow list instead
+ */
+void Frontend::retire(const Transaction &tx)
+{
+    Ticket *ticket = static_cast<Ticket *>(tx.data());
+    Completion done = {ticket->data, tx.addr(), tx.len(), tx.is_read(),
+                       tx.arrive_cycle(), tx.finish_cycle()};
+    Producer *producer = producers_[ticket->producer];
+    if (!producer->overflow.empty() || !producer->completions.push(done)) {
+        producer->overflow.push_back(done);
+    }
+    tickets_.destroy(ticket);
+}
+
+
+/*
+ * Move the overflowed completions to their queues, as many as fit
+ */
+void Frontend::deliver()
+{
+    for (auto producer : producers_) {
+        vector<Completion> &overflow = producer->overflow;
+        size_t num_done = 0;
+        while (num_done < overflow.size() &&
+               producer->completions.push(overflow[num_done])) num_done++;
+        overflow.erase(overflow.begin(), overflow.begin() + num_done);
+    }
+}
+
+
+/*
+ * Check if every producer has finished and got all its completions
+ */
+bool Frontend::done() const
+{
+    if (!pending_.empty() || tickets_.size()) return false;
+    for (auto producer : producers_) {
+        if (producer->clock.load(memory_order_acquire) != MAX_CYCLE ||
+            !producer->requests.empty() || !producer->overflow.empty())
+            return false;
+    }
+    return true;
+}
+
+}
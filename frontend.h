@@ -0,0 +1,155 @@
+/* Copyright (c) 2014, Jue Wang
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef FRONTEND_H
+#define FRONTEND_H
+
+#include <vector>
+#include <atomic>
+
+#include "macro.h"
+#include "memory_system.h"
+#include "transaction.h"
+#include "spsc_queue.h"
+#include "pool.h"
+
+namespace membles
+{
+
+/*
+ * Let several host threads submit transactions to one memory system
+ * Every producer thread has its own lock-free queue of requests and its own
+ *   queue of completions, so producers never wait for each other, and the
+ *   simulation thread is the only one touching the memory system.
+ * A producer stamps every request with the memory controller cycle it is
+ *   due at, and publishes a clock: it submits nothing before that cycle
+ *   from then on. The simulation thread only simulates a cycle once every
+ *   clock has passed it, and admits the requests due in producer order, then
+ *   in submission order. The memory system thus sees the same transactions
+ *   in the same order on every run, however the threads are scheduled.
+ * The requests due are taken while waiting for the clock of their producer,
+ *   so a producer may submit more requests in a cycle than its queue holds.
+ * A producer has to keep its clock going while it waits for a completion,
+ *   otherwise the simulation waits for it forever. In parallel mode the
+ *   completions come some cycles after their finish cycles.
+ */
+class Frontend
+{
+
+  public:
+
+    // a finished request, handed back to its producer
+    struct Completion {
+        void *data;
+        uint64_t addr;
+        uint32_t len;
+        bool is_read;
+        Cycle arrive_cycle;
+        Cycle finish_cycle;
+    };
+
+    Frontend(MemorySystem *membles);
+    ~Frontend();
+
+    // register the callbacks of the memory system, which must not be
+    //   registered by anyone else, and allocate the queues
+    void init(uint32_t num_producer, size_t depth);
+
+    // the following are called by producer thread i only
+
+    // queue a request due at a cycle, return false if the queue is full, or
+    //   if the request is longer than max_len() of the memory system, which
+    //   is an error
+    // cycles of a producer never go down
+    bool submit(uint32_t i, Cycle cycle, uint64_t addr, uint32_t len,
+                bool is_read, void *data = nullptr);
+    // promise that nothing is submitted before a cycle from now on
+    void advance(uint32_t i, Cycle cycle);
+    // promise that nothing is submitted any more
+    void finish(uint32_t i);
+    // get a completion, return false if there is none
+    bool complete(uint32_t i, Completion &done);
+
+    // the following is called by the simulation thread
+
+    // simulate the next cycle that has something to do, return false once
+    //   every producer has finished and every request is completed
+    bool step();
+
+  private:
+
+    // a request waiting to be admitted
+    struct Request {
+        Cycle cycle;
+        uint64_t addr;
+        uint32_t len;
+        bool is_read;
+        void *data;
+    };
+
+    struct Producer {
+        SpscQueue<Request> requests;
+        SpscQueue<Completion> completions;
+        // clock of the producer, nothing is submitted before it
+        atomic<Cycle> clock;
+        // completions not fitting in the queue, owned by the simulation
+        //   thread
+        vector<Completion> overflow;
+    };
+
+    // the owner of an admitted transaction, kept as its data
+    struct Ticket {
+        Ticket(uint32_t producer, void *data)
+            : producer(producer),
+              data(data)
+        {}
+        uint32_t producer;
+        void *data;
+    };
+
+    MemorySystem *membles_;
+
+    vector<Producer *> producers_;
+
+    // admitted transactions not accepted by the memory system yet, in order
+    vector<Transaction *> pending_;
+    // the earliest cycle worth retrying the pending transactions
+    Cycle retry_cycle_;
+
+    // one ticket for every admitted transaction not completed yet
+    Pool<Ticket> tickets_;
+
+    bool admit(uint32_t i, Cycle cycle);
+    void retire(const Transaction &tx);
+    void deliver();
+    bool done() const;
+
+};
+
+}
+
+#endif
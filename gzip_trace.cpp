@@ -0,0 +1,147 @@
+/* Copyright (c) 2014, Jue Wang
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <cstring>
+#include <fstream>
+
+#include <zlib.h>
+#include <sys/stat.h>
+
+#include "gzip_trace.h"
+
+namespace membles
+{
+
+/*
+ * Check if a file is gzip-compressed, by its extension or its magic
+ * Only the magic of a regular file is checked, since peeking at a pipe would
+ *   eat its data
+ */
+bool IsGzipTrace(const string &filename)
+{
+    size_t dot_pos = filename.find_last_of(".");
+    if (dot_pos != string::npos && filename.substr(dot_pos) == ".gz")
+        return true;
+    struct stat st;
+    if (stat(filename.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) return false;
+    ifstream file(filename.c_str(), ios_base::in | ios_base::binary);
+    char magic[2];
+    if (!file.read(magic, sizeof(magic))) return false;
+    return (uint8_t)magic[0] == 0x1f && (uint8_t)magic[1] == 0x8b;
+}
+
+
+/* ctor: Gzip Trace Reader
+ * Set the size of the inflate buffer, which grows for longer lines
+ */
+GzipTraceReader::GzipTraceReader(size_t buf_size)
+    : file_(nullptr),
+      buf_(buf_size),
+      begin_(0),
+      end_(0),
+      eof_(false)
+{}
+
+
+/* dtor: Gzip Trace Reader
+ * Close the stream
+ */
+GzipTraceReader::~GzipTraceReader()
+{
+    if (file_) gzclose(file_);
+}
+
+
+/*
+ * Open a gzip-compressed trace file
+ */
+bool GzipTraceReader::open(const string &filename)
+{
+    filename_ = filename;
+    file_ = gzopen(filename.c_str(), "rb");
+    if (!file_) {
+        ERROR("Could not open trace file <" << filename << ">.");
+        return false;
+    }
+    // inflate in large chunks
+    gzbuffer(file_, 1 << 17);
+    return true;
+}
+
+
+/*
+ * Parse lines until one of them carries a transaction
+ */
+bool GzipTraceReader::next(TraceRecord &record)
+{
+    while (true) {
+        const char *begin = buf_.data() + begin_;
+        const char *end = buf_.data() + end_;
+        const char *eol = (const char *)memchr(begin, '\n', end - begin);
+        if (eol) {
+            begin_ = eol + 1 - buf_.data();
+            if (ParseTraceLine(begin, eol, record)) return true;
+        } else if (!eof_) {
+            if (!fill()) return false;
+        } else if (begin < end) {
+            // the last line has no line break
+            begin_ = end_;
+            return ParseTraceLine(begin, end, record);
+        } else {
+            return false;
+        }
+    }
+}
+
+
+/*
+ * Move the unparsed bytes to the front of the buffer and inflate more
+ * Return false on a decompression error
+ */
+bool GzipTraceReader::fill()
+{
+    size_t left = end_ - begin_;
+    if (begin_ > 0) {
+        memmove(buf_.data(), buf_.data() + begin_, left);
+        begin_ = 0;
+        end_ = left;
+    }
+    // a line longer than the buffer
+    if (end_ == buf_.size()) buf_.resize(buf_.size() * 2);
+    int len = gzread(file_, buf_.data() + end_, buf_.size() - end_);
+    if (len < 0) {
+        int err = 0;
+        ERROR(filename_ << ": " << gzerror(file_, &err));
+        eof_ = true;
+        return false;
+    }
+    end_ += len;
+    if (len == 0) eof_ = true;
+    return true;
+}
+
+}
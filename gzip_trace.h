@@ -0,0 +1,85 @@
+/* Copyright (c) 2014, Jue Wang
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef GZIP_TRACE_H
+#define GZIP_TRACE_H
+
+#include <string>
+#include <vector>
+
+#include "macro.h"
+#include "trace.h"
+
+struct gzFile_s;
+
+namespace membles
+{
+
+bool IsGzipTrace(const string &filename);
+
+
+/*
+ * Read a gzip-compressed text trace, which is inflated as a stream
+ * Lines are parsed in place in the inflate buffer, with the same syntax as
+ *   TextTraceReader
+ */
+class GzipTraceReader : public TraceReader
+{
+
+  public:
+
+    GzipTraceReader(size_t buf_size = 1 << 20);
+    ~GzipTraceReader();
+
+    bool open(const string &filename);
+
+    bool next(TraceRecord &record);
+
+  private:
+
+    gzFile_s *file_;
+    string filename_;
+
+    // inflated bytes, [begin_, end_) is not parsed yet
+    vector<char> buf_;
+    size_t begin_;
+    size_t end_;
+
+    // the whole file has been inflated
+    bool eof_;
+
+    bool fill();
+
+    // a gzip stream must not be shared
+    GzipTraceReader(const GzipTraceReader &);
+    GzipTraceReader &operator=(const GzipTraceReader &);
+
+};
+
+}
+
+#endif
@@ -31,12 +31,19 @@
 
 #include <iostream>
 #include <cstdint>
+#include <cstdlib>
 #include <fstream>
 #include <sstream>
+#include <thread>
 #include <getopt.h>
 
 #include "memory_system.h"
 #include "transaction.h"
+#include "trace.h"
+#include "driver.h"
+#include "sweep.h"
+#include "calibration.h"
+#include "sampler.h"
 
 using namespace membles;
 
@@ -44,8 +51,12 @@ void
 usage()
 {
     cout << "Membles Usage: " << endl;
-    cout << "membles -t trace -d spec/device.spec [-s ctrl/system.ctrl] "
-         << endl << "        [-o output] [-v] [-h]" << endl;
+    cout << "membles -t trace -d spec/device.spec [-c ctrl/system.ctrl] "
+         << endl << "        [-o output [-b]] [-S stats] [-p cycles] "
+         << "[-s sweep [-j jobs]]" << endl << "        [-k cycle,checkpoint] "
+         << "[-r checkpoint]" << endl
+         << "        [-m period,measure[,warmup] [-j jobs]] [-w requests] "
+         << "[-R] [-a | -C] [-l]" << endl << "        [-v] [-h]" << endl;
     cout << "  -t, --trace=FILE                  specify a trace file to run"
          << endl;
     cout << "  -d, --device=FILE1[,FILE2,...]    specify a list of device "
@@ -54,93 +65,52 @@ usage()
          << "configurations" << endl;
     cout << "  -o, --output=FILE                 specify a file name for all "
          << "the outputs" << endl << "                                      "
-         << "e.g. FILE.log, FILE.csv, and FILE.trc" << endl;
+         << "e.g. FILE.log, FILE.csv, FILE.trc, and FILE.tx" << endl;
+    cout << "  -b, --binary-log                  write the command and "
+         << "transaction logs" << endl << "                                    "
+         << "  in binary, e.g. FILE.trc.bin and FILE.tx.bin" << endl;
+    cout << "  -S, --stats=FILE                  write the statistics of the "
+         << "run to FILE" << endl << "                                    "
+         << "  as JSON, - for the standard output" << endl;
+    cout << "  -p, --parallel=CYCLES             simulate each channel on its "
+         << "own thread," << endl << "                                    "
+         << "  merging outputs every CYCLES cycles" << endl;
+    cout << "  -s, --sweep=FILE                  simulate every combination of "
+         << "the parameter" << endl << "                                    "
+         << "  values in FILE, results go to the CSV output" << endl;
+    cout << "  -j, --jobs=N                      number of threads running a "
+         << "sweep or" << endl << "                                    "
+         << "  sampling windows" << endl;
+    cout << "  -k, --checkpoint=CYCLE,FILE       save the simulator state to "
+         << "FILE once CYCLE" << endl << "                                    "
+         << "  is reached" << endl;
+    cout << "  -r, --restore=FILE                resume from a checkpoint, "
+         << "which is" << endl << "                                    "
+         << "  taken with the same trace" << endl;
+    cout << "  -m, --sample=P,M[,W]              simulate W + M records in "
+         << "detail every P" << endl << "                                    "
+         << "  records and fast-forward the rest, reporting" << endl
+         << "                                      the metrics of the M "
+         << "records (W=M by default)" << endl;
+    cout << "  -w, --warmup=N                    only open the rows of the "
+         << "first N" << endl << "                                    "
+         << "  requests, simulating the rest in detail" << endl;
+    cout << "  -R, --roi                         simulate in detail only "
+         << "between the" << endl << "                                    "
+         << "  ROI_BEGIN and ROI_END markers of the trace" << endl;
+    cout << "  -a, --fast                        approximate the timing "
+         << "instead of" << endl << "                                    "
+         << "  simulating every command, e.g. for a quick sweep" << endl;
+    cout << "  -C, --calibrate                   replay the trace in both "
+         << "simulation and" << endl << "                                    "
+         << "  fast mode, and report the error of fast mode" << endl;
+    cout << "  -l, --lockstep                    simulate every cycle instead "
+         << "of skipping" << endl << "                                    "
+         << "  idle cycles" << endl;
     cout << "  -v, --verbose                     enable verbosity" << endl;
     cout << "  -h, --help                        print this message" << endl;
 }
 
-bool parse_trace(string line, uint64_t &time, uint64_t &addr, uint32_t &len,
-                 bool is_read, uint16_t &priority, void *data)
-{
-    // skip empty lines
-    if (line.empty()) return false;
-    // skip comment line
-    if (line[0] == '#') return false;
-    // get cycle
-    size_t space_pos = line.find_first_of(" \t");
-    if (space_pos == string::npos) {
-        WARN("Insuffient field");
-        return false;
-    }
-    istringstream ss(line.substr(0, space_pos));
-    if ((ss >> dec >> time).fail()) {
-        WARN("Fail to parse timestamp");
-        return false;
-    }
-    line.erase(0, space_pos + 1);
-    // get read/write
-    space_pos = line.find_first_of(" \t");
-    if (space_pos == string::npos) {
-        WARN("Insufficient field");
-        return false;
-    }
-    string rw = to_upper(line.substr(0, space_pos));
-    if (rw == "R") {
-        is_read = true;
-    } else if (rw == "W") {
-        is_read = false;
-    } else {
-        WARN("Fail to parse R/W field " << rw);
-        return false;
-    }
-    line.erase(0, space_pos + 1);
-    // get starting address
-    space_pos = line.find_first_of(" \t");
-    if (space_pos == string::npos) {
-        WARN("Insufficient field");
-        return false;
-    }
-    if (line.substr(0, 2) != "0x") {
-        WARN("Address should be a hex (starting with 0x)");
-        return false;
-    }
-    ss.clear();
-    ss.str(line.substr(2, space_pos - 2));
-    if ((ss >> hex >> addr).fail()) {
-        WARN("Fail to parse starting address");
-        return false;
-    }
-    line.erase(0, space_pos + 1);
-    // get transaction size
-    space_pos = line.find_first_of(" \t");
-    if (space_pos == string::npos) {
-        WARN("Insufficient field");
-        return false;
-    }
-    ss.clear();
-    ss.str(line.substr(0, space_pos));
-    if ((ss >> dec >> len).fail()) {
-        WARN("Fail to parse transaction size");
-        return false;
-    }
-    line.erase(0, space_pos + 1);
-    // get priority level
-    space_pos = line.find_first_of(" \t");
-    ss.clear();
-    ss.str(line.substr(0, space_pos));
-    if ((ss >> dec >> priority).fail()) {
-        WARN("Fail to parse priority level");
-        return false;
-    }
-    line.erase(0, space_pos + 1);
-
-
-    // TODO: handle data
-
-    // success
-    return true;
-}
-
 vector<string> parse_dev_filenames(string str)
 {
     vector<string> filenames;
@@ -178,7 +148,23 @@ int main(int argc, char *argv[])
     vector<string> dev_filenames;
     vector<uint64_t> mem_sizes;
     string output_prefix;
+    bool binary_log = false;
+    string stats_filename;
     bool verbose = false;
+    bool lockstep = false;
+    uint64_t num_warmup = 0;
+    bool roi = false;
+    bool fast = false;
+    bool calibrate = false;
+    Cycle lookahead = 0;
+    string sweep_filename;
+    Cycle checkpoint_cycle = MAX_CYCLE;
+    string checkpoint_filename;
+    string restore_filename;
+    uint64_t sample_period = 0;
+    uint64_t sample_measure = 0;
+    uint64_t sample_warmup = 0;
+    uint32_t num_jobs = thread::hardware_concurrency();
 
     // if user does not specify "-c", then replay the trace to its end
     uint64_t max_cycle = UINT64_MAX;
@@ -196,12 +182,26 @@ int main(int argc, char *argv[])
             {"device", required_argument, 0, 'd'},
             {"ctrl", required_argument, 0, 'c'},
             {"output", required_argument, 0, 'o'},
+            {"binary-log", no_argument, 0, 'b'},
+            {"stats", required_argument, 0, 'S'},
+            {"parallel", required_argument, 0, 'p'},
+            {"sweep", required_argument, 0, 's'},
+            {"jobs", required_argument, 0, 'j'},
+            {"checkpoint", required_argument, 0, 'k'},
+            {"restore", required_argument, 0, 'r'},
+            {"sample", required_argument, 0, 'm'},
+            {"warmup", required_argument, 0, 'w'},
+            {"roi", no_argument, 0, 'R'},
+            {"fast", no_argument, 0, 'a'},
+            {"calibrate", no_argument, 0, 'C'},
+            {"lockstep", no_argument, 0, 'l'},
             {"verbose", no_argument, 0, 'v'},
             {"help", no_argument, 0, 'h'},
             {0, 0, 0, 0}
         };
         int opt_index = 0; //for getopt
-        int c = getopt_long(argc, argv, "t:d:c:o:vh", long_opts, &opt_index);
+        int c = getopt_long(argc, argv, "t:d:c:o:bS:p:s:j:k:r:m:w:RaClvh",
+                            long_opts, &opt_index);
         if (c == -1) break;
         switch (c) {
         case 'h':
@@ -214,12 +214,71 @@ int main(int argc, char *argv[])
         case 'o':
             output_prefix = string(optarg);
             break;
+        case 'b':
+            binary_log = true;
+            break;
+        case 'S':
+            stats_filename = string(optarg);
+            break;
         case 'c':
             ctrl_filename = string(optarg);
             break;
         case 'd':
             dev_filenames = parse_dev_filenames(optarg);
             break;
+        case 'p':
+            lookahead = strtoull(optarg, NULL, 10);
+            if (lookahead == 0) {
+                ERROR("The lookahead of parallel mode should be positive.");
+                exit(-1);
+            }
+            break;
+        case 's':
+            sweep_filename = string(optarg);
+            break;
+        case 'j':
+            num_jobs = strtoul(optarg, NULL, 10);
+            break;
+        case 'k': {
+            char *end = NULL;
+            checkpoint_cycle = strtoull(optarg, &end, 10);
+            if (end == optarg || *end != ',' || *(end + 1) == '\0') {
+                ERROR("A checkpoint should be given as CYCLE,FILE.");
+                exit(-1);
+            }
+            checkpoint_filename = string(end + 1);
+            break;
+        }
+        case 'r':
+            restore_filename = string(optarg);
+            break;
+        case 'm': {
+            char *end = NULL;
+            sample_period = strtoull(optarg, &end, 10);
+            if (*end == ',') sample_measure = strtoull(end + 1, &end, 10);
+            sample_warmup = sample_measure;
+            if (*end == ',') sample_warmup = strtoull(end + 1, &end, 10);
+            if (*end != '\0' || sample_period == 0 || sample_measure == 0) {
+                ERROR("Sampling should be given as PERIOD,MEASURE[,WARMUP].");
+                exit(-1);
+            }
+            break;
+        }
+        case 'w':
+            num_warmup = strtoull(optarg, NULL, 10);
+            break;
+        case 'R':
+            roi = true;
+            break;
+        case 'a':
+            fast = true;
+            break;
+        case 'C':
+            calibrate = true;
+            break;
+        case 'l':
+            lockstep = true;
+            break;
         case 'v':
             verbose = true;
             break;
@@ -249,71 +308,170 @@ int main(int argc, char *argv[])
         mem_sizes.push_back(1024);
     }
 
+    // fast mode never steps the memory system
+    if ((fast || calibrate) && (lookahead || !checkpoint_filename.empty() ||
+                                !restore_filename.empty() || sample_period)) {
+        ERROR("Fast mode cannot be combined with -p, -k, -r or -m.");
+        exit(-1);
+    }
+
+    // calibration compares both modes on the whole trace
+    if (calibrate) {
+        if (!sweep_filename.empty() || num_warmup || roi) {
+            ERROR("Calibration cannot be combined with -s, -w or -R.");
+            exit(-1);
+        }
+        TraceReader *reader = OpenTrace(trace_filename);
+        if (!reader) {
+            usage();
+            exit(-1);
+        }
+        Calibration calibration;
+        bool success = calibration.run(ctrl_filename, dev_filenames,
+                                       mem_sizes, reader);
+        delete reader;
+        if (!success) {
+            ERROR("Aborted");
+            exit(-1);
+        }
+        cout << endl;
+        cout << "-------------------------------------------------------"
+             << endl;
+        cout << "   Calibration Complete" << endl;
+        calibration.report(cout);
+        cout << "-------------------------------------------------------"
+             << endl;
+        exit(0);
+    }
+
+    // sampling reads the trace once, and simulates only parts of it
+    if (sample_period) {
+        if (!sweep_filename.empty() || lookahead ||
+                !checkpoint_filename.empty() || !restore_filename.empty() ||
+                num_warmup || roi) {
+            ERROR("Sampling cannot be combined with -s, -p, -k, -r, -w or -R.");
+            exit(-1);
+        }
+        TraceReader *reader = OpenTrace(trace_filename,
+                                        thread::hardware_concurrency() > 1);
+        if (!reader) {
+            usage();
+            exit(-1);
+        }
+        Sampler sampler(sample_period, sample_measure, sample_warmup);
+        bool success = sampler.run(ctrl_filename, dev_filenames, mem_sizes,
+                                   reader, num_jobs);
+        delete reader;
+        if (!success) {
+            ERROR("Aborted");
+            exit(-1);
+        }
+        cout << endl;
+        cout << "-------------------------------------------------------"
+             << endl;
+        cout << "   Sampled Simulation Complete" << endl;
+        sampler.report(cout);
+        cout << "-------------------------------------------------------"
+             << endl;
+        exit(0);
+    }
+
+    // load the trace once and share it among all the runs of a sweep
+    if (!sweep_filename.empty()) {
+        Sweep sweep;
+        if (!sweep.ReadFile(sweep_filename)) {
+            ERROR("Aborted");
+            exit(-1);
+        }
+        TraceReader *reader = OpenTrace(trace_filename);
+        if (!reader) {
+            usage();
+            exit(-1);
+        }
+        vector<TraceRecord> trace;
+        TraceRecord record;
+        while (reader->next(record)) trace.push_back(record);
+        delete reader;
+        string csv_filename = (output_prefix.empty() ? string("sweep") :
+                               output_prefix) + ".csv";
+        ofstream csv(csv_filename.c_str());
+        if (!csv.is_open()) {
+            ERROR("Cannot open file " << csv_filename << ".");
+            exit(-1);
+        }
+        // every run writes its own logs if asked to
+        if (!output_prefix.empty()) sweep.set_output(output_prefix, binary_log);
+        if (!restore_filename.empty()) sweep.set_checkpoint(restore_filename);
+        sweep.set_warmup(num_warmup);
+        if (fast) sweep.set_fast();
+        if (roi) sweep.set_roi();
+        bool success = sweep.run(ctrl_filename, dev_filenames, mem_sizes,
+                                 trace, num_jobs, csv);
+        cout << endl;
+        cout << "-------------------------------------------------------"
+             << endl;
+        cout << "   Sweep Complete" << endl;
+        cout << "   Runs: " << sweep.size() << ", results in " << csv_filename
+             << endl;
+        cout << "-------------------------------------------------------"
+             << endl;
+        exit(success ? 0 : -1);
+    }
+
     // instantiate a Membles
     MemorySystem membles;
     if (verbose) membles.set_verbose();
+    if (lookahead) membles.set_parallel(lookahead);
+    if (fast) membles.set_fast();
+    // the command and transaction logs are only written if asked to
+    if (!output_prefix.empty()) membles.set_output(output_prefix, binary_log);
     if (!membles.init(ctrl_filename, dev_filenames, mem_sizes)) {
         ERROR("Aborted");
         exit(-1);
     }
 
-    Transaction *pending_tx = nullptr;
-
-    // read trace file
-    ifstream file;
-    string line;
-    file.open(trace_filename.c_str());
-
-    if (!file.is_open()) {
-        ERROR("Could not open trace file <" << trace_filename << ">.");
+    // read trace file, ahead of the simulation if there is a spare core
+    bool prefetch = thread::hardware_concurrency() > 1;
+    TraceReader *reader = OpenTrace(trace_filename, prefetch);
+    if (!reader) {
         usage();
         exit(-1);
     }
 
-    Cycle next_cycle = 0;
+    Driver driver(&membles, reader);
+    if (lockstep) driver.set_lockstep();
+    driver.set_warmup(num_warmup);
+    if (roi) driver.set_roi();
+    driver.set_max_cycle(max_cycle);
+    if (!checkpoint_filename.empty()) {
+        driver.set_checkpoint(checkpoint_cycle, checkpoint_filename);
+    }
+    if (!restore_filename.empty() && !driver.restore(restore_filename)) {
+        ERROR("Aborted");
+        exit(-1);
+    }
+    Cycle cycles = driver.run();
+    delete reader;
 
-    for (Cycle cycle = 0; cycle < max_cycle; ++cycle) {
-        if (!pending_tx && cycle >= next_cycle) {
-            if (!file.eof()) {
-                getline(file, line);
-                uint64_t timestamp = 0;
-                uint64_t addr = 0;
-                uint32_t len = 0;
-                uint16_t priority = 0;
-                bool is_read = true;
-                bool success = parse_trace(line, timestamp, addr, len, is_read,
-                               priority, NULL);
-                if (success) {
-                    // calculate cycle
-                    // timestamp in picosecond, frequency in MHz
-                    next_cycle = (Cycle)(timestamp / 1e6 * membles.freq());
-                    Transaction *next_tx = new Transaction(addr, len, is_read);
-                    if (priority) next_tx->set_priority(priority);
-                    if (cycle < next_cycle || !membles.AddTx(next_tx)) {
-                        pending_tx = next_tx;
-                    }
-                }
-            }
-        } else if (cycle >= next_cycle && membles.AddTx(pending_tx)) {
-            pending_tx = nullptr;
+    if (stats_filename == "-") {
+        membles.stat(cout, driver.roi_cycle());
+    } else if (!stats_filename.empty()) {
+        ofstream stats(stats_filename.c_str());
+        if (stats) {
+            membles.stat(stats, driver.roi_cycle());
+        } else {
+            ERROR("Cannot open file " << stats_filename << ".");
         }
-
-        membles.step();
-
-        // quit when trace is fully replayed
-        if (file.eof() && !pending_tx && !membles.busy()) break;
     }
 
-    file.close();
-    membles.stat();
-
-    // delete remaining pending transactions
-    if (pending_tx) delete pending_tx;
-    
     // print out completion message
     cout << endl;
     cout << "-------------------------------------------------------" << endl;
     cout << "   Simulation Complete" << endl;
-    cout << "   Cycles Elapsed: " << membles.cycle() << endl;
+    cout << "   Cycles Elapsed: " << cycles << endl;
+    if (num_warmup || roi) {
+        cout << "   Region of Interest: from cycle " << driver.roi_cycle()
+             << endl;
+    }
     cout << "-------------------------------------------------------" << endl;
 }
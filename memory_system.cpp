@@ -24,6 +24,8 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <thread>
+
 #include "memory_system.h"
 
 namespace membles
@@ -35,27 +37,34 @@ namespace membles
 MemorySystem::MemorySystem()
     : BaseObj(),
       num_chan_(1),
-      chan_itlv_bit_(10)
+      chan_itlv_bit_(10),
+      binary_output_(false),
+      tx_count_(0),
+      fast_(false),
+      parallel_(false),
+      lookahead_(0),
+      next_barrier_(0)
 {}
 
 
 /* dtor: Memory System
- * deallocate output stream if necesary
+ * stop the workers, write out the remaining records and deallocate output
+ *   stream if necesary
  */
 MemorySystem::~MemorySystem()
 {
-    if (log_) {
-        log_->close();
-        delete log_;
-    }
-    if (csv_) {
-        csv_->close();
-        delete csv_;
-    }
-    if (trc_) {
-        trc_->close();
-        delete trc_;
+    if (!workers_.empty()) {
+        for (auto worker : workers_) {
+            worker->advance(cycle_);
+            worker->stop();
+        }
+        FlushTrace();
+        for (auto worker : workers_) delete worker;
     }
+    // closing is done by the file stream destructors
+    if (log_) delete log_;
+    if (csv_) delete csv_;
+    writer_.close();
 }
 
 
@@ -70,17 +79,37 @@ bool MemorySystem::init(const string &ctrl_filename,
                         const vector<string> &dev_filenames,
                         vector<uint64_t> sizes)
 {
-    // TODO: just for test
-    trc_ = new ofstream;
-    trc_->open("test.trc", ios_base::out | ios_base::trunc);
+    // open outputs
+    if (!output_prefix_.empty()) {
+        if (!writer_.open(output_prefix_, binary_output_)) return false;
+        trc_ = &writer_;
+    }
 
     sizes_ = sizes;
     bool success = true;
     // load controller configuration file
     success &= ctrl_cfg_.ReadFile(ctrl_filename);
+    // apply the controller parameters given by the user, and make sure every
+    //   parameter belongs to one of the configurations
+    for (auto &param : params_) {
+        if (ctrl_cfg_.has(param.first)) {
+            success &= ctrl_cfg_.set(param.first, param.second);
+        } else if (!DevCfg().has(param.first)) {
+            ERROR(param.first << " is not a valid parameter name.");
+            return false;
+        }
+    }
     num_chan_ = ctrl_cfg_.num_chan;
+    if (num_chan_ > MAX_CMD_INDEX + 1) {
+        ERROR("A memory system can have no more than " << MAX_CMD_INDEX + 1
+              << " channels");
+        return false;
+    }
     chan_itlv_bit_ = ctrl_cfg_.chan_itlv_bit;
     freq_ = ctrl_cfg_.ctrl_freq;
+    if (success && ctrl_cfg_.epoch && !output_prefix_.empty() &&
+            !writer_.OpenEpochs(output_prefix_))
+        return false;
     // load device configuration files
     if (num_chan_ < dev_filenames.size()) {
         ERROR("User provides " << dev_filenames.size() << " device "
@@ -102,6 +131,11 @@ bool MemorySystem::init(const string &ctrl_filename,
         size_t index = i;
         if (index >= dev_filenames.size()) index = dev_filenames.size() - 1;
         success &= dev_cfgs_[i].ReadFile(dev_filenames[index]);
+        // apply the device parameters given by the user
+        for (auto &param : params_) {
+            if (!dev_cfgs_[i].has(param.first)) continue;
+            success &= dev_cfgs_[i].set(param.first, param.second);
+        }
     }
     // set channel capacity
     sizes_.resize(num_chan_);
@@ -127,11 +161,41 @@ bool MemorySystem::init(const string &ctrl_filename,
 
     // create components
     // create N channels depending on the input setting
+    // in parallel mode, every channel keeps its records in a buffer of its
+    //   worker, and the buffers are merged at the barriers
     channels_.resize(num_chan_);
+    cmd_pools_.resize(num_chan_);
+    full_queues_.resize(2 * num_chan_);
+    if (parallel_) {
+        workers_.resize(num_chan_);
+        for (auto &worker : workers_) worker = new ChannelWorker;
+    }
     for (size_t i = 0; i < num_chan_; ++i) {
+        RecordSink *trc = trc_;
+        if (parallel_ && trc_) trc = &(workers_[i]->records());
         if (verbose_) channels_[i].set_verbose();
-        success &= channels_[i].init(i, &ctrl_cfg_, &(dev_cfgs_[i]), log_,
-                                     csv_, trc_);
+        success &= channels_[i].init(i, &tx_pool_, &(cmd_pools_[i]),
+                                     &ctrl_cfg_, &(dev_cfgs_[i]), log_, csv_,
+                                     trc);
+        channels_[i].set_callbacks(&read_done_, &write_done_);
+    }
+    // fast mode approximates every channel instead
+    if (fast_) {
+        fast_channels_.resize(num_chan_);
+        for (size_t i = 0; i < num_chan_; ++i) {
+            success &= fast_channels_[i].init(i, &tx_pool_, &ctrl_cfg_,
+                                              &(dev_cfgs_[i]), trc_);
+            fast_channels_[i].set_callbacks(&read_done_, &write_done_);
+        }
+    }
+    if (!success) return false;
+
+    // launch the workers
+    if (parallel_) {
+        for (size_t i = 0; i < num_chan_; ++i) {
+            workers_[i]->init(&(channels_[i]), &ctrl_cfg_);
+            workers_[i]->start();
+        }
     }
 
     return success;
@@ -146,22 +210,111 @@ void MemorySystem::step()
     // TODO
     cycle_++;
 
+    if (parallel_) {
+        publish();
+        return;
+    }
+
     for (size_t i = 0; i < num_chan_; ++i) {
         channels_[i].step();
     }
 }
 
 
+/*
+ * Return the earliest cycle that any channel has something to do
+ * In parallel mode the workers skip idle cycles on their own, so the caller
+ *   only needs to stop at its own events
+ */
+Cycle MemorySystem::NextEvent() const
+{
+    if (parallel_) return MAX_CYCLE;
+    Cycle next = MAX_CYCLE;
+    for (size_t i = 0; i < num_chan_; ++i) {
+        next = min(next, channels_[i].NextEvent());
+    }
+    return next;
+}
+
+
+/*
+ * Jump to a cycle without simulating the idle cycles in between
+ * The cycle must be no later than NextEvent()
+ */
+void MemorySystem::SkipTo(Cycle cycle)
+{
+    cycle_ = cycle;
+
+    if (parallel_) {
+        publish();
+        return;
+    }
+
+    for (size_t i = 0; i < num_chan_; ++i) {
+        channels_[i].SkipTo(cycle);
+    }
+}
+
+
 /*
  * Find which channel a transaciton belongs to
  */
 uint32_t MemorySystem::FindChanId(Transaction *tx)
 {
     assert(tx);
+    return ChanId(tx->addr());
+}
+
+
+/*
+ * Find which channel an address belongs to
+ */
+uint32_t MemorySystem::ChanId(uint64_t addr) const
+{
     if (num_chan_ == 1) return 0;
-    uint64_t mask = (1UL << num_chan_) - 1;
-    return (tx->addr() >> chan_itlv_bit_) & mask;
-}  
+    // the number of channels is a power of 2
+    uint64_t mask = num_chan_ - 1;
+    return (addr >> chan_itlv_bit_) & mask;
+}
+
+
+/*
+ * Return the statistics of the channel that runs in the current mode
+ */
+const ChanStats &MemorySystem::ChanStatsOf(uint32_t chan) const
+{
+    if (fast_) return fast_channels_[chan].stats();
+    return channels_[chan].stats();
+}
+
+
+/*
+ * Allocate a transaction from the memory system
+ * The transaction is given back automatically when it is retired, otherwise
+ *   it has to be returned through FreeTx()
+ * The data is not looked at, it is only handed back to the callbacks
+ * Return nullptr if the transaction is longer than max_len(), since no
+ *   channel could ever take it
+ */
+Transaction *MemorySystem::NewTx(uint64_t addr, uint32_t len, bool is_read,
+                                 void *data)
+{
+    if (len > max_len()) {
+        ERROR("Found a transaction whose length is larger than channel "
+              "interleaving granularity");
+        return nullptr;
+    }
+    return tx_pool_.create(tx_count_++, addr, len, is_read, data);
+}
+
+
+/*
+ * Return a transaction that has never been accepted by AddTx()
+ */
+void MemorySystem::FreeTx(Transaction *tx)
+{
+    tx_pool_.destroy(tx);
+}
 
 
 /*
@@ -170,22 +323,400 @@ uint32_t MemorySystem::FindChanId(Transaction *tx)
  */
 bool MemorySystem::AddTx(Transaction *tx)
 {
-    if (tx->len() > (1UL << chan_itlv_bit_)) {
-        ERROR("Found a transaction whose length is larger than channel "
-              "interleaving granularity");
-        return false;
+    uint32_t chan = FindChanId(tx);
+    if (!parallel_) return channels_[chan].AddTx(tx);
+    // the channel only has to be looked at when it might be full
+    ChannelWorker *worker = workers_[chan];
+    if (!worker->MightAccept(tx)) {
+        sync(chan);
+        if (!worker->MightAccept(tx)) return false;
     }
+    worker->push(cycle_, tx);
+    return true;
+}
+
+
+/*
+ * Check if a transaction would be accepted by the memory system right now
+ */
+bool MemorySystem::CanAccept(Transaction *tx)
+{
     uint32_t chan = FindChanId(tx);
-    return channels_[chan].AddTx(tx);
+    if (!parallel_) return channels_[chan].CanAccept(tx);
+    ChannelWorker *worker = workers_[chan];
+    if (!worker->MightAccept(tx)) sync(chan);
+    return worker->MightAccept(tx);
 }
 
 
 /*
- * Print some statistics of the memory system
+ * Return the earliest cycle that a transaction might be accepted
+ * A full channel can only make room at a step that does something, so the
+ *   transaction is worth retrying right after the next event of the channel
  */
-void MemorySystem::stat()
+Cycle MemorySystem::RetryCycle(Transaction *tx)
 {
-    // TODO
+    if (CanAccept(tx)) return cycle_;
+    // a rejected channel has caught up in parallel mode, so it can be read
+    Cycle next = channels_[FindChanId(tx)].NextEvent();
+    // a channel filled up since its last step has nothing scheduled yet, but
+    //   dispatches at its next step
+    return next == MAX_CYCLE ? cycle_ + 1 : next + 1;
+}
+
+
+/*
+ * Add a batch of transactions in order
+ * The accepted transactions are taken out of the batch, and the rejected ones
+ *   stay in their order. Once a queue rejects a transaction, the later ones
+ *   for the same queue are rejected too, so a queue never takes them out of
+ *   order.
+ * Return the earliest cycle worth retrying the rejected transactions, or
+ *   MAX_CYCLE if there are none
+ */
+Cycle MemorySystem::AddTxs(vector<Transaction *> &txs)
+{
+    fill(full_queues_.begin(), full_queues_.end(), false);
+    Cycle retry = MAX_CYCLE;
+    size_t num_left = 0;
+    for (auto tx : txs) {
+        size_t queue = 2 * FindChanId(tx) + tx->is_read();
+        if (!full_queues_[queue] && AddTx(tx)) continue;
+        if (!full_queues_[queue]) {
+            full_queues_[queue] = true;
+            retry = min(retry, RetryCycle(tx));
+        }
+        txs[num_left++] = tx;
+    }
+    txs.resize(num_left);
+    return retry;
+}
+
+
+/*
+ * Register the callbacks of the caller, before or after init()
+ * A callback may be called at any step, from inside the channel that retires
+ *   the transaction, so it must not add transactions. In parallel mode the
+ *   callbacks are called later, when the memory system takes the retired
+ *   transactions back from the workers, and finish_cycle() of a transaction
+ *   tells when it retired.
+ */
+void MemorySystem::RegisterCallbacks(const TxCallback &read_done,
+                                     const TxCallback &write_done)
+{
+    read_done_ = read_done;
+    write_done_ = write_done;
+}
+
+
+/*
+ * Write the statistics of every channel and their totals as a JSON object
+ * Only retired transactions count, and the bandwidth is taken over the cycles
+ *   from start on.
+ */
+void MemorySystem::stat(ostream &os, Cycle start)
+{
+    // let every channel catch up before looking at it
+    if (parallel_) barrier();
+
+    Cycle cycles = cycle_ > start ? cycle_ - start : 0;
+    vector<double> peaks(num_chan_);
+    Histogram rd_latency, wr_latency;
+    BankStats total = BankStats();
+    uint64_t num_cmd = 0;
+    uint64_t stalls[NUM_STALL] = {};
+    vector<Histogram> stages;
+    if (ctrl_cfg_.lifecycle_sample) stages.resize(NUM_STAGE);
+    uint64_t bytes = 0;
+    uint64_t num_bank = 0;
+    double peak = 0;
+    for (uint32_t i = 0; i < num_chan_; ++i) {
+        const DevCfg &dev_cfg = dev_cfgs_[i];
+        num_bank += dev_cfg.num_rank * dev_cfg.num_bank;
+        // GB/s
+        peaks[i] = ctrl_cfg_.chan_width / 8.0 * dev_cfg.data_rate_ /
+                   dev_cfg.tCK;
+        peak += peaks[i];
+        const ChanStats &stats = ChanStatsOf(i);
+        rd_latency.merge(stats.rd_latency());
+        wr_latency.merge(stats.wr_latency());
+        total.add(stats.total());
+        // a simulated channel issues a command or stalls in every cycle
+        Cycle accounted = stats.num_cmd();
+        for (int s = 0; s < NUM_STALL; ++s) {
+            stalls[s] += stats.stalls()[s];
+            accounted += stats.stalls()[s];
+        }
+        assert(fast_ || accounted == cycle_ - stats.since());
+        (void)accounted;
+        num_cmd += stats.num_cmd();
+        for (size_t s = 0; s < stages.size(); ++s)
+            stages[s].merge(stats.stages()[s]);
+        bytes += stats.bytes();
+    }
+    double bandwidth = cycles ? (double)bytes / cycles * freq_ / 1e3 : 0;
+
+    os << "{\"cycles\": " << cycles << ", \"frequency\": " << freq_ << ",\n";
+    os << " \"bandwidth\": " << bandwidth << ", \"peak_bandwidth\": " << peak
+       << ", \"utilization\": " << (peak ? bandwidth / peak : 0) << ",\n";
+    os << " \"read_latency\": ";
+    rd_latency.report(os);
+    os << ",\n \"write_latency\": ";
+    wr_latency.report(os);
+    os << ",\n ";
+    total.report(os, cycles * num_bank);
+    os << ",\n \"commands\": " << num_cmd << ", ";
+    ReportStalls(os, stalls, true);
+    if (!stages.empty()) {
+        os << ",\n ";
+        ReportLifecycle(os, stages);
+    }
+    os << ",\n \"channels\": [";
+    for (uint32_t i = 0; i < num_chan_; ++i) {
+        os << (i ? "," : "") << "\n    {\"channel\": " << i << ", ";
+        ChanStatsOf(i).report(os, cycles, freq_, peaks[i]);
+        os << "}";
+    }
+    os << "]}" << endl;
+}
+
+
+/*
+ * Work out the figures a run is usually compared by, the way stat() does
+ */
+void MemorySystem::summary(Cycle start, double &bandwidth, double &rd_latency,
+                           double &wr_latency, double &row_hit_rate)
+{
+    if (parallel_) barrier();
+
+    Cycle cycles = cycle_ > start ? cycle_ - start : 0;
+    Histogram rd, wr;
+    BankStats total = BankStats();
+    uint64_t bytes = 0;
+    for (uint32_t i = 0; i < num_chan_; ++i) {
+        const ChanStats &stats = ChanStatsOf(i);
+        rd.merge(stats.rd_latency());
+        wr.merge(stats.wr_latency());
+        total.add(stats.total());
+        bytes += stats.bytes();
+    }
+    uint64_t num_tx = total.num_outcome[ROW_HIT] +
+                      total.num_outcome[ROW_MISS] +
+                      total.num_outcome[ROW_CONFLICT];
+    bandwidth = cycles ? (double)bytes / cycles * freq_ / 1e3 : 0;
+    rd_latency = rd.mean();
+    wr_latency = wr.mean();
+    row_hit_rate = num_tx ? (double)total.num_outcome[ROW_HIT] / num_tx : 0;
+}
+
+
+/*
+ * Start the statistics of every channel over from the current cycle, where
+ *   the region of interest begins
+ */
+void MemorySystem::ResetStats()
+{
+    // the workers must be waiting before their channels are touched
+    if (parallel_) barrier();
+    for (auto &chan : channels_) chan.ResetStats();
+    for (auto &chan : fast_channels_) chan.ResetStats();
+}
+
+
+/*
+ * Keep stepping the channels until they have nothing left to do
+ */
+void MemorySystem::drain()
+{
+    if (!parallel_) {
+        for (Cycle next = NextEvent(); next != MAX_CYCLE; next = NextEvent()) {
+            if (next > cycle_) SkipTo(next);
+            step();
+        }
+        return;
+    }
+    // the workers wait at a barrier, so their channels can be looked at, and
+    //   every next event is simulated the way step() does it
+    while (true) {
+        barrier();
+        Cycle next = MAX_CYCLE;
+        for (auto &chan : channels_) next = min(next, chan.NextEvent());
+        if (next == MAX_CYCLE) break;
+        cycle_ = max(cycle_, next) + 1;
+    }
+}
+
+
+/*
+ * Bring an idle memory system back to where init() leaves it, which is much
+ *   cheaper than creating a new one
+ */
+void MemorySystem::reset()
+{
+    assert(!parallel_ && tx_pool_.size() == 0);
+    cycle_ = 0;
+    tx_count_ = 0;
+    for (auto &chan : channels_) chan.reset();
+    for (auto &chan : fast_channels_) chan.reset();
+}
+
+
+/*
+ * Open the row of an address in its channel
+ */
+void MemorySystem::warm(uint64_t addr, uint32_t len)
+{
+    if (fast_) {
+        fast_channels_[ChanId(addr)].warm(addr, len);
+    } else {
+        channels_[ChanId(addr)].warm(addr, len);
+    }
+}
+
+
+/*
+ * Return the earliest cycle from the given one that a transaction can be
+ *   accepted under approximate timing
+ */
+Cycle MemorySystem::AcceptCycle(Transaction *tx, Cycle cycle)
+{
+    assert(fast_);
+    return fast_channels_[ChanId(tx->addr())].AcceptCycle(tx->is_read(),
+                                                          cycle);
+}
+
+
+/*
+ * Accept a transaction at the given cycle under approximate timing
+ */
+void MemorySystem::estimate(Transaction *tx, Cycle cycle)
+{
+    assert(fast_);
+    FastChannel &chan = fast_channels_[ChanId(tx->addr())];
+    chan.estimate(tx, cycle);
+    cycle_ = max(cycle_, chan.cycle());
+}
+
+
+/*
+ * Retire the remaining transactions under approximate timing
+ * The memory system moves to the cycle after the last retirement
+ */
+void MemorySystem::settle()
+{
+    assert(fast_);
+    for (auto &chan : fast_channels_) {
+        chan.settle();
+        cycle_ = max(cycle_, chan.cycle());
+    }
+}
+
+
+/*
+ * Collect the open rows of every channel
+ */
+void MemorySystem::GetOpenRows(vector<uint32_t> &rows) const
+{
+    rows.clear();
+    if (fast_) {
+        for (auto &chan : fast_channels_) chan.GetOpenRows(rows);
+    } else {
+        for (auto &chan : channels_) chan.GetOpenRows(rows);
+    }
+}
+
+
+/*
+ * Open the rows collected by GetOpenRows() from a memory system of the same
+ *   geometry
+ */
+void MemorySystem::SetOpenRows(const vector<uint32_t> &rows)
+{
+    size_t pos = 0;
+    for (size_t i = 0; i < num_chan_; ++i) {
+        assert(pos < rows.size());
+        if (fast_) {
+            fast_channels_[i].SetOpenRows(&(rows[pos]));
+        } else {
+            channels_[i].SetOpenRows(&(rows[pos]));
+        }
+        pos += dev_cfgs_[i].num_rank * dev_cfgs_[i].num_bank;
+    }
+    assert(pos == rows.size());
+}
+
+
+/*
+ * Save the memory system, starting with its geometry
+ */
+void MemorySystem::save(CheckpointWriter &out)
+{
+    // let every channel catch up before looking at it
+    if (parallel_) barrier();
+    out.put(num_chan_);
+    for (auto &dev_cfg : dev_cfgs_) {
+        out.put(dev_cfg.num_rank);
+        out.put(dev_cfg.num_bank);
+    }
+    out.put(cycle_);
+    out.put(tx_count_);
+    for (auto &chan : channels_) chan.save(out);
+}
+
+
+/*
+ * Restore what save() wrote into a memory system of the same geometry
+ */
+bool MemorySystem::restore(CheckpointReader &in)
+{
+    uint32_t num_chan = in.get();
+    bool match = (num_chan == num_chan_);
+    for (uint32_t i = 0; i < num_chan && in.good(); ++i) {
+        uint32_t num_rank = in.get();
+        uint32_t num_bank = in.get();
+        match &= (i < num_chan_ && num_rank == dev_cfgs_[i].num_rank &&
+                  num_bank == dev_cfgs_[i].num_bank);
+    }
+    if (!in.good()) return false;
+    if (!match) {
+        ERROR(in.filename() << " is taken from a memory system with different "
+              "channels, ranks or banks.");
+        return false;
+    }
+
+    // the workers must leave the channels alone until they are restored
+    for (auto worker : workers_) worker->stop();
+    cycle_ = in.get();
+    tx_count_ = in.get();
+    for (auto &chan : channels_) {
+        if (!chan.restore(in)) return false;
+    }
+    if (parallel_) {
+        next_barrier_ = (cycle_ / lookahead_ + 1) * lookahead_;
+        for (size_t i = 0; i < num_chan_; ++i) {
+            workers_[i]->init(&(channels_[i]), &ctrl_cfg_);
+            workers_[i]->start();
+        }
+    }
+    return true;
+}
+
+
+/*
+ * Save a transaction that is not in any channel, e.g. one waiting for room
+ */
+void MemorySystem::SaveTx(CheckpointWriter &out, const Transaction *tx) const
+{
+    PutTx(out, tx);
+}
+
+
+/*
+ * Allocate a transaction saved by SaveTx()
+ */
+Transaction *MemorySystem::RestoreTx(CheckpointReader &in)
+{
+    return GetTx(in, &tx_pool_);
 }
 
 
@@ -201,4 +732,178 @@ void MemorySystem::set_verbose()
     // TODO
 }
 
+
+/*
+ * Override a parameter of the controller or the device configuration, which
+ *   takes effect after the configuration files are read
+ * Must be called before init()
+ */
+void MemorySystem::set_param(const string &key, const string &val)
+{
+    params_.push_back(make_pair(key, val));
+}
+
+
+/*
+ * Write the outputs to files named after a prefix, e.g. PREFIX.trc, in text or
+ *   in binary
+ * Must be called before init()
+ */
+void MemorySystem::set_output(const string &prefix, bool binary)
+{
+    output_prefix_ = prefix;
+    binary_output_ = binary;
+}
+
+
+/*
+ * Send the records to a sink instead of the output files
+ * Must be called before init()
+ */
+void MemorySystem::set_sink(RecordSink *sink)
+{
+    trc_ = sink;
+}
+
+
+/*
+ * Simulate every channel on its own thread
+ * The channel records are merged every lookahead cycles
+ * A transaction a channel might reject makes the caller wait for that
+ *   channel to catch up, so a replay that keeps the queues full spends most
+ *   of its time handing over between threads rather than overlapping them.
+ * Must be called before init()
+ */
+void MemorySystem::set_parallel(Cycle lookahead)
+{
+    assert(lookahead > 0);
+    parallel_ = true;
+    lookahead_ = lookahead;
+    next_barrier_ = lookahead;
+}
+
+
+/*
+ * Approximate the timing of every channel instead of simulating it, see
+ *   FastChannel
+ * Must be called before init()
+ */
+void MemorySystem::set_fast()
+{
+    fast_ = true;
+}
+
+
+/*
+ * Move the horizon on once per lookahead window
+ * The workers simulate a window while the caller goes through the next one.
+ *   The records can only be merged from channels that stopped at the same
+ *   cycle though, so the workers have to catch up first when there are any.
+ */
+void MemorySystem::publish()
+{
+    reclaim();
+    if (cycle_ < next_barrier_) return;
+    if (trc_) {
+        barrier();
+        return;
+    }
+    for (auto worker : workers_) worker->advance(cycle_);
+    next_barrier_ = (cycle_ / lookahead_ + 1) * lookahead_;
+}
+
+
+/*
+ * Wait for a channel to catch up with the memory system
+ * The channel stays untouched until the horizon moves on, so its state can be
+ *   read safely afterwards
+ */
+void MemorySystem::sync(uint32_t chan)
+{
+    ChannelWorker *worker = workers_[chan];
+    worker->advance(cycle_);
+    while (!worker->CaughtUp(cycle_)) {
+        // a worker cannot move on if its retire queue is full
+        reclaim();
+        worker->wait(cycle_);
+    }
+    worker->refresh();
+}
+
+
+/*
+ * Wait for every channel, then merge their records
+ */
+void MemorySystem::barrier()
+{
+    for (uint32_t i = 0; i < num_chan_; ++i) sync(i);
+    FlushTrace();
+    next_barrier_ = (cycle_ / lookahead_ + 1) * lookahead_;
+}
+
+
+/*
+ * Give the transactions retired by the workers back to the pool
+ */
+void MemorySystem::reclaim()
+{
+    for (auto worker : workers_) {
+        Transaction *tx = worker->reclaim();
+        while (tx) {
+            const TxCallback &done = tx->is_read() ? read_done_ : write_done_;
+            if (done) done(*tx);
+            tx_pool_.destroy(tx);
+            tx = worker->reclaim();
+        }
+    }
+}
+
+
+/*
+ * Write the records of every buffer to a sink, ordered by cycle and then by
+ *   channel, which is the order the serial mode writes them in
+ * Every buffer is ordered by cycle already, and is emptied
+ */
+template<class Record>
+static void MergeRecords(vector<vector<Record> *> &bufs,
+                         Cycle Record::*cycle, RecordSink *sink,
+                         void (RecordSink::*write)(const Record &))
+{
+    vector<size_t> pos(bufs.size(), 0);
+    while (true) {
+        size_t selected = bufs.size();
+        for (size_t i = 0; i < bufs.size(); ++i) {
+            if (pos[i] == bufs[i]->size()) continue;
+            if (selected == bufs.size() ||
+                (*bufs[i])[pos[i]].*cycle <
+                (*bufs[selected])[pos[selected]].*cycle)
+                selected = i;
+        }
+        if (selected == bufs.size()) break;
+        (sink->*write)((*bufs[selected])[pos[selected]++]);
+    }
+    for (auto buf : bufs) buf->clear();
+}
+
+
+/*
+ * Merge the record buffers of the workers into the outputs
+ * Every worker must have caught up
+ */
+void MemorySystem::FlushTrace()
+{
+    if (!trc_) return;
+    vector<vector<CmdRecord> *> cmds(num_chan_);
+    vector<vector<TxRecord> *> txs(num_chan_);
+    vector<vector<EpochRecord> *> epochs(num_chan_);
+    for (uint32_t i = 0; i < num_chan_; ++i) {
+        cmds[i] = &(workers_[i]->records().cmds());
+        txs[i] = &(workers_[i]->records().txs());
+        epochs[i] = &(workers_[i]->records().epochs());
+    }
+    MergeRecords(cmds, &CmdRecord::cycle, trc_, &RecordSink::command);
+    MergeRecords(txs, &TxRecord::finish_cycle, trc_, &RecordSink::retire);
+    MergeRecords(epochs, &EpochRecord::end_cycle, trc_, &RecordSink::epoch);
+}
+
 }
@@ -34,7 +34,13 @@
 #include "macro.h"
 #include "base_obj.h"
 #include "channel.h"
+#include "fast_channel.h"
 #include "transaction.h"
+#include "command.h"
+#include "pool.h"
+#include "channel_worker.h"
+#include "output.h"
+#include "checkpoint.h"
 
 using namespace std;
 
@@ -55,14 +61,72 @@ class MemorySystem : public BaseObj
 
     void step();
 
+    Cycle NextEvent() const;
+    void SkipTo(Cycle cycle);
+
     uint32_t FindChanId(Transaction *tx);
 
-    bool AddTx(Transaction *tx);
+    Transaction *NewTx(uint64_t addr, uint32_t len, bool is_read,
+                       void *data = nullptr);
+    void FreeTx(Transaction *tx);
 
-    void stat();
+    bool AddTx(Transaction *tx);
+    bool CanAccept(Transaction *tx);
+    Cycle RetryCycle(Transaction *tx);
+    // add a batch of transactions, the rejected ones are left in the batch
+    Cycle AddTxs(vector<Transaction *> &txs);
+
+    // called whenever a read or a write retires, either may be empty
+    // the callbacks must not add transactions, see RegisterCallbacks()
+    void RegisterCallbacks(const TxCallback &read_done,
+                           const TxCallback &write_done);
+
+    // write the statistics since a cycle as JSON
+    void stat(ostream &os, Cycle start);
+    // the headline figures of stat(): bandwidth in GB/s, mean read and write
+    //   latencies in cycles and row-hit rate
+    void summary(Cycle start, double &bandwidth, double &rd_latency,
+                 double &wr_latency, double &row_hit_rate);
+    // start the statistics over from the current cycle
+    void ResetStats();
+
+    // simulate until every transaction is retired
+    void drain();
+    // go back to cycle 0, no transaction may be in the memory system
+    void reset();
+
+    // row buffer state, see Channel::GetOpenRows()
+    void warm(uint64_t addr, uint32_t len);
+    void GetOpenRows(vector<uint32_t> &rows) const;
+    void SetOpenRows(const vector<uint32_t> &rows);
+
+    // approximate timing without stepping, see FastChannel::estimate()
+    // fast mode only, and not to be mixed with AddTx()
+    Cycle AcceptCycle(Transaction *tx, Cycle cycle);
+    void estimate(Transaction *tx, Cycle cycle);
+    // retire every transaction accepted so far
+    void settle();
+
+    // the complete simulator state, restore() must be called right after
+    //   init()
+    void save(CheckpointWriter &out);
+    bool restore(CheckpointReader &in);
+    // transactions held by the caller
+    void SaveTx(CheckpointWriter &out, const Transaction *tx) const;
+    Transaction *RestoreTx(CheckpointReader &in);
 
     Frequency freq() const { return freq_; }
+    // the longest transaction, which must stay in one channel
+    uint32_t max_len() const { return 1U << chan_itlv_bit_; }
+    // minimum access length of the channel an address maps to
+    uint32_t mal(uint64_t addr) const { return dev_cfgs_[ChanId(addr)].mal; }
     void set_verbose();
+    void set_parallel(Cycle lookahead);
+    void set_fast();
+    bool fast() const { return fast_; }
+    void set_param(const string &key, const string &val);
+    void set_output(const string &prefix, bool binary = false);
+    void set_sink(RecordSink *sink);
 
   private:
 
@@ -78,8 +142,56 @@ class MemorySystem : public BaseObj
     CtrlCfg ctrl_cfg_;
     vector<DevCfg> dev_cfgs_;
 
+    // parameters overriding the configuration files, in the order given
+    vector<pair<string, string>> params_;
+
+    // output file name without extension, no output if empty
+    string output_prefix_;
+    // write fixed-width binary records instead of text
+    bool binary_output_;
+    OutputWriter writer_;
+
+    // number of transactions created so far, which numbers the next one
+    uint64_t tx_count_;
+
+    // allocators for transactions and commands, which are recycled once
+    //   a transaction is retired
+    // every channel has its own command allocator, so channels running on
+    //   different threads never share one
+    Pool<Transaction> tx_pool_;
+    vector<Pool<Command>> cmd_pools_;
+
+    // completion callbacks of the caller
+    TxCallback read_done_;
+    TxCallback write_done_;
+
     // components
     vector<Channel> channels_;
+
+    // fast mode: the channels are approximated instead of simulated
+    bool fast_;
+    vector<FastChannel> fast_channels_;
+
+    // the queues AddTxs() finds full, two per channel, kept between calls
+    //   to save an allocation per batch
+    vector<bool> full_queues_;
+
+    // parallel mode: each channel is simulated by a worker thread
+    bool parallel_;
+    // number of cycles between two merges of the channel records
+    Cycle lookahead_;
+    Cycle next_barrier_;
+    vector<ChannelWorker *> workers_;
+
+    uint32_t ChanId(uint64_t addr) const;
+    // the statistics of a channel in the current mode
+    const ChanStats &ChanStatsOf(uint32_t chan) const;
+
+    void publish();
+    void sync(uint32_t chan);
+    void barrier();
+    void reclaim();
+    void FlushTrace();
 };
 
 }
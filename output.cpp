@@ -0,0 +1,237 @@
+/* Copyright (c) 2014, Jue Wang
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <cstring>
+
+#include "output.h"
+#include "command.h"
+
+namespace membles
+{
+
+const uint16_t OUTPUT_VERSION = 1;
+
+// the longest text lines
+const size_t MAX_CMD_LINE = 128;
+const size_t MAX_TX_LINE = 128;
+const size_t MAX_EPOCH_LINE = 256;
+
+
+/*
+ * Helpers of the text formatting, which print into a reserved buffer and
+ *   return the end of what they printed
+ */
+static inline char *PutStr(char *pos, const char *str)
+{
+    while (*str) *pos++ = *str++;
+    return pos;
+}
+
+static inline char *PutDec(char *pos, uint64_t val)
+{
+    char digits[20];
+    size_t n = 0;
+    do {
+        digits[n++] = '0' + val % 10;
+        val /= 10;
+    } while (val);
+    while (n) *pos++ = digits[--n];
+    return pos;
+}
+
+static inline char *PutHex(char *pos, uint64_t val)
+{
+    char digits[16];
+    size_t n = 0;
+    do {
+        digits[n++] = "0123456789ABCDEF"[val & 0xf];
+        val >>= 4;
+    } while (val);
+    while (n) *pos++ = digits[--n];
+    return pos;
+}
+
+static void WriteHeader(AsyncWriter &writer, const char *magic,
+                        uint16_t record_size)
+{
+    char header[8];
+    memcpy(header, magic, 4);
+    header[4] = (char)OUTPUT_VERSION;
+    header[5] = (char)(OUTPUT_VERSION >> 8);
+    header[6] = (char)record_size;
+    header[7] = (char)(record_size >> 8);
+    writer.write(header, sizeof(header));
+}
+
+
+/* ctor: Output Writer
+ * Text mode by default
+ */
+OutputWriter::OutputWriter()
+    : binary_(false)
+{}
+
+
+/*
+ * Create the log files
+ */
+bool OutputWriter::open(const string &prefix, bool binary)
+{
+    binary_ = binary;
+    if (binary_) {
+        if (!cmd_log_.open(prefix + ".trc.bin")) return false;
+        if (!tx_log_.open(prefix + ".tx.bin")) return false;
+        WriteHeader(cmd_log_, "MBCL", sizeof(CmdRecord));
+        WriteHeader(tx_log_, "MBXL", sizeof(TxRecord));
+    } else {
+        if (!cmd_log_.open(prefix + ".trc")) return false;
+        if (!tx_log_.open(prefix + ".tx")) return false;
+    }
+    return true;
+}
+
+
+/*
+ * Create the epoch file, only once the controller configuration asks for
+ *   epochs
+ */
+bool OutputWriter::OpenEpochs(const string &prefix)
+{
+    if (!epoch_log_.open(prefix + ".csv")) return false;
+    const char *header = "channel,start,end,reads,writes,bandwidth,"
+        "avg_latency,max_latency,row_hit_rate,read_queue,write_queue,"
+        "drain_cycles\n";
+    epoch_log_.write(header, strlen(header));
+    return true;
+}
+
+
+/*
+ * Flush and close the log files
+ */
+bool OutputWriter::close()
+{
+    bool success = cmd_log_.close();
+    success &= tx_log_.close();
+    success &= epoch_log_.close();
+    return success;
+}
+
+
+/*
+ * Log an issued command
+ */
+void OutputWriter::command(const CmdRecord &record)
+{
+    if (binary_) {
+        cmd_log_.write(&record, sizeof(record));
+        return;
+    }
+    char *begin = cmd_log_.reserve(MAX_CMD_LINE);
+    char *pos = PutStr(begin, "CH");
+    pos = PutDec(pos, record.chan);
+    *pos++ = ' ';
+    pos = PutDec(pos, record.cycle);
+    switch (record.type) {
+    case READ:
+        pos = PutStr(pos, " READ ");
+        break;
+    case WRITE:
+        pos = PutStr(pos, " WRITE ");
+        break;
+    case ACTIVATE:
+        pos = PutStr(pos, " ROWACT ");
+        break;
+    case PRECHARGE:
+        pos = PutStr(pos, " PRECHARGE ");
+        break;
+    default:
+        pos = PutStr(pos, " UNKNOWN ");
+    }
+    pos = PutDec(pos, record.tx_id);
+    *pos++ = ' ';
+    pos = PutDec(pos, record.rank);
+    *pos++ = ' ';
+    pos = PutDec(pos, record.bank);
+    *pos++ = ' ';
+    pos = PutDec(pos, record.row);
+    *pos++ = ' ';
+    pos = PutDec(pos, record.col);
+    *pos++ = '\n';
+    cmd_log_.commit(pos - begin);
+}
+
+
+/*
+ * Log a retired transaction
+ */
+void OutputWriter::retire(const TxRecord &record)
+{
+    if (binary_) {
+        tx_log_.write(&record, sizeof(record));
+        return;
+    }
+    char *begin = tx_log_.reserve(MAX_TX_LINE);
+    char *pos = PutStr(begin, "CH");
+    pos = PutDec(pos, record.chan);
+    *pos++ = ' ';
+    pos = PutDec(pos, record.finish_cycle);
+    pos = PutStr(pos, record.is_read ? " R " : " W ");
+    pos = PutDec(pos, record.tx_id);
+    pos = PutStr(pos, " 0x");
+    pos = PutHex(pos, record.addr);
+    *pos++ = ' ';
+    pos = PutDec(pos, record.len);
+    *pos++ = ' ';
+    pos = PutDec(pos, record.arrive_cycle);
+    *pos++ = '\n';
+    tx_log_.commit(pos - begin);
+}
+
+
+
+/*
+ * Log the record of an epoch, which is rare enough for printf
+ */
+void OutputWriter::epoch(const EpochRecord &record)
+{
+    char *begin = epoch_log_.reserve(MAX_EPOCH_LINE);
+    int len = snprintf(begin, MAX_EPOCH_LINE,
+                       "%u,%llu,%llu,%llu,%llu,%.4f,%.2f,%llu,%.4f,%.2f,"
+                       "%.2f,%llu\n", record.chan,
+                       (unsigned long long)record.start_cycle,
+                       (unsigned long long)record.end_cycle,
+                       (unsigned long long)record.num_rd,
+                       (unsigned long long)record.num_wr,
+                       record.bandwidth, record.avg_latency,
+                       (unsigned long long)record.max_latency,
+                       record.row_hit_rate, record.rd_queue, record.wr_queue,
+                       (unsigned long long)record.drain_cycles);
+    epoch_log_.commit(min(len, (int)MAX_EPOCH_LINE - 1));
+}
+
+}
@@ -0,0 +1,181 @@
+/* Copyright (c) 2014, Jue Wang
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <string>
+#include <vector>
+
+#include "macro.h"
+#include "async_writer.h"
+
+namespace membles
+{
+
+/*
+ * A bus command issued by a scheduler
+ */
+struct CmdRecord {
+    Cycle cycle;
+    uint64_t tx_id;
+    uint32_t row;
+    uint32_t col;
+    uint8_t chan;
+    uint8_t rank;
+    uint8_t bank;
+    // CmdType
+    uint8_t type;
+    uint32_t reserved;
+};
+
+
+/*
+ * A transaction retired by a channel
+ */
+struct TxRecord {
+    // accepted by the channel
+    Cycle arrive_cycle;
+    // retired
+    Cycle finish_cycle;
+    uint64_t tx_id;
+    uint64_t addr;
+    uint32_t len;
+    uint8_t chan;
+    uint8_t is_read;
+    uint16_t priority;
+};
+
+
+/*
+ * What a channel did in an epoch of cycles [start_cycle, end_cycle)
+ * Latency and bandwidth count the transactions retired in the epoch, and the
+ *   queue depths are averaged over its cycles.
+ */
+struct EpochRecord {
+    Cycle start_cycle;
+    Cycle end_cycle;
+    uint32_t chan;
+    uint64_t num_rd;
+    uint64_t num_wr;
+    // GB/s
+    double bandwidth;
+    double avg_latency;
+    Cycle max_latency;
+    // of the transactions dispatched in the epoch
+    double row_hit_rate;
+    double rd_queue;
+    double wr_queue;
+    // cycles spent draining writes
+    Cycle drain_cycles;
+};
+
+
+/*
+ * Where the records of a simulation go
+ */
+class RecordSink
+{
+
+  public:
+
+    virtual ~RecordSink() {}
+
+    virtual void command(const CmdRecord &record) = 0;
+    virtual void retire(const TxRecord &record) = 0;
+    // only written if the controller configuration asks for epochs
+    virtual void epoch(const EpochRecord &record) {}
+
+};
+
+
+/*
+ * Keep records in memory, which are written out later
+ */
+class RecordBuffer : public RecordSink
+{
+
+  public:
+
+    void command(const CmdRecord &record) { cmds_.push_back(record); }
+    void retire(const TxRecord &record) { txs_.push_back(record); }
+    void epoch(const EpochRecord &record) { epochs_.push_back(record); }
+
+    vector<CmdRecord> &cmds() { return cmds_; }
+    vector<TxRecord> &txs() { return txs_; }
+    vector<EpochRecord> &epochs() { return epochs_; }
+
+  private:
+
+    vector<CmdRecord> cmds_;
+    vector<TxRecord> txs_;
+    vector<EpochRecord> epochs_;
+
+};
+
+
+/*
+ * Write the command log and the transaction completion log of a simulation
+ *   next to each other
+ * Text mode writes PREFIX.trc and PREFIX.tx, one record per line:
+ *   CH<chan> <cycle> <READ|WRITE|ROWACT|PRECHARGE> <tx> <rank> <bank> <row>
+ *     <col>
+ *   CH<chan> <finish cycle> <R|W> <tx> 0x<address> <length> <arrive cycle>
+ * Binary mode writes PREFIX.trc.bin and PREFIX.tx.bin, an 8-byte header
+ *   (magic "MBCL" or "MBXL", version (u16), record size (u16)) followed by
+ *   the records as laid out in CmdRecord and TxRecord, little-endian
+ * The epochs, if any, go to PREFIX.csv in either mode, one row per epoch and
+ *   channel after a header row
+ */
+class OutputWriter : public RecordSink
+{
+
+  public:
+
+    OutputWriter();
+
+    bool open(const string &prefix, bool binary);
+    bool OpenEpochs(const string &prefix);
+    bool close();
+
+    void command(const CmdRecord &record);
+    void retire(const TxRecord &record);
+    void epoch(const EpochRecord &record);
+
+  private:
+
+    bool binary_;
+
+    AsyncWriter cmd_log_;
+    AsyncWriter tx_log_;
+    AsyncWriter epoch_log_;
+
+};
+
+}
+
+#endif
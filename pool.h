@@ -0,0 +1,126 @@
+/* Copyright (c) 2014, Jue Wang
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef POOL_H
+#define POOL_H
+
+#include <vector>
+#include <utility>
+#include <type_traits>
+
+#include "macro.h"
+
+namespace membles
+{
+
+/*
+ * A slab allocator for fixed-size objects
+ * Memory is grabbed from the heap one slab at a time and never given back
+ *   until the pool is destroyed. Released objects are kept in a free list and
+ *   handed out again, so a steady-state simulation does not call malloc.
+ * Objects still alive when the pool is destroyed are not destructed, which is
+ *   fine for the plain records (Transaction, Command) it is used for.
+ */
+template <class T>
+class Pool
+{
+
+  public:
+
+    Pool(size_t slab_size = 1024)
+        : slab_size_(slab_size),
+          free_(nullptr),
+          num_alive_(0)
+    {}
+
+    ~Pool()
+    {
+        for (auto slab : slabs_) delete [] slab;
+    }
+
+    // construct an object of type T, or of a type U derived from T that adds
+    //   no data members
+    template <class U = T, class... Args>
+    U *create(Args&&... args)
+    {
+        static_assert(sizeof(U) <= sizeof(Slot), "object too large for pool");
+        if (!free_) grow();
+        Slot *slot = free_;
+        free_ = slot->next;
+        num_alive_++;
+        return new (slot) U(std::forward<Args>(args)...);
+    }
+
+    // destruct an object and put its slot back to the free list
+    void destroy(T *obj)
+    {
+        assert(obj && num_alive_);
+        obj->~T();
+        Slot *slot = reinterpret_cast<Slot *>(obj);
+        slot->next = free_;
+        free_ = slot;
+        num_alive_--;
+    }
+
+    // number of objects handed out but not destroyed yet
+    size_t size() const { return num_alive_; }
+
+    // number of objects the pool can hold without growing
+    size_t capacity() const { return slabs_.size() * slab_size_; }
+
+  private:
+
+    union Slot {
+        Slot *next;
+        typename aligned_storage<sizeof(T), alignof(T)>::type storage;
+    };
+
+    // number of objects per slab
+    size_t slab_size_;
+
+    vector<Slot *> slabs_;
+
+    // list of released slots
+    Slot *free_;
+
+    size_t num_alive_;
+
+    // allocate one more slab and thread it onto the free list
+    void grow()
+    {
+        Slot *slab = new Slot[slab_size_];
+        slabs_.push_back(slab);
+        for (size_t i = slab_size_; i > 0; --i) {
+            slab[i - 1].next = free_;
+            free_ = &(slab[i - 1]);
+        }
+    }
+
+};
+
+}
+
+#endif
@@ -0,0 +1,312 @@
+/* Copyright (c) 2014, Jue Wang
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <iomanip>
+
+#include "sampler.h"
+#include "memory_system.h"
+#include "driver.h"
+#include "output.h"
+
+namespace membles
+{
+
+// confidence level of the reported intervals: 95%
+const double CONFIDENCE_Z = 1.96;
+
+
+/*
+ * A window to be simulated in detail: the row buffers left by the
+ *   fast-forwarding and the records of the window
+ */
+struct SampleWindow {
+    size_t index;
+    vector<uint32_t> rows;
+    vector<TraceRecord> records;
+};
+
+
+/*
+ * Measure the transactions of a window from its records
+ * Transaction IDs restart from 0 in every window, so the measured ones are
+ *   those numbered after the warmup records
+ */
+class WindowStats : public RecordSink
+{
+
+  public:
+
+    void reset(uint64_t first_id)
+    {
+        first_id_ = first_id;
+        num_act_ = 0;
+        num_tx_ = 0;
+        bytes_ = 0;
+        latency_ = 0;
+        first_cycle_ = MAX_CYCLE;
+        last_cycle_ = 0;
+    }
+
+    void command(const CmdRecord &record)
+    {
+        if (record.type == ACTIVATE && record.tx_id >= first_id_) num_act_++;
+    }
+
+    void retire(const TxRecord &record)
+    {
+        if (record.tx_id < first_id_) return;
+        num_tx_++;
+        bytes_ += record.len;
+        latency_ += record.finish_cycle - record.arrive_cycle;
+        first_cycle_ = min(first_cycle_, record.arrive_cycle);
+        last_cycle_ = max(last_cycle_, record.finish_cycle);
+    }
+
+    // return false if no transaction is measured
+    bool measure(Frequency freq, SampleResult &result) const
+    {
+        if (num_tx_ == 0) return false;
+        Cycle span = last_cycle_ - first_cycle_ + 1;
+        // bytes per cycle * MHz = MB/s
+        result.bandwidth = (double)bytes_ / span * freq / 1e3;
+        result.latency = (double)latency_ / num_tx_;
+        result.row_hit_rate = 1.0 - (double)num_act_ / num_tx_;
+        return true;
+    }
+
+  private:
+
+    uint64_t first_id_;
+    uint64_t num_act_;
+    uint64_t num_tx_;
+    uint64_t bytes_;
+    uint64_t latency_;
+    Cycle first_cycle_;
+    Cycle last_cycle_;
+
+};
+
+
+/*
+ * Simulate a window on a memory system that has finished the previous one
+ */
+static bool SimulateWindow(MemorySystem &membles, WindowStats &stats,
+                           const SampleWindow &window, uint64_t warmup,
+                           SampleResult &result)
+{
+    membles.reset();
+    membles.SetOpenRows(window.rows);
+    stats.reset(warmup);
+    MemTraceReader reader(window.records);
+    Driver driver(&membles, &reader);
+    driver.run();
+    // the measured transactions still in flight are part of the window
+    membles.drain();
+    return stats.measure(membles.freq(), result);
+}
+
+
+/*
+ * Estimate a metric by its mean over the windows, and return the half width
+ *   of its confidence interval
+ */
+static double Estimate(const vector<double> &samples, double &mean)
+{
+    size_t n = samples.size();
+    mean = 0;
+    for (auto x : samples) mean += x;
+    mean /= n;
+    if (n < 2) return 0;
+    double var = 0;
+    for (auto x : samples) var += (x - mean) * (x - mean);
+    var /= n - 1;
+    return CONFIDENCE_Z * sqrt(var / n);
+}
+
+
+/* ctor: Sampler
+ * Set the period and the window size, in number of trace records
+ */
+Sampler::Sampler(uint64_t period, uint64_t measure, uint64_t warmup)
+    : period_(period),
+      measure_(measure),
+      warmup_(warmup),
+      num_records_(0)
+{}
+
+
+/*
+ * Read a trace to its end, fast-forwarding it on the calling thread and
+ *   simulating the windows on num_jobs threads
+ * Return false if the memory system cannot be set up or nothing is measured
+ */
+bool Sampler::run(const string &ctrl_filename,
+                  const vector<string> &dev_filenames,
+                  const vector<uint64_t> &sizes,
+                  TraceReader *reader, uint32_t num_jobs)
+{
+    results_.clear();
+    num_records_ = 0;
+    if (measure_ == 0 || warmup_ + measure_ > period_) {
+        ERROR("A sampling window should measure at least one record and fit "
+              "in its period.");
+        return false;
+    }
+
+    // the memory system that fast-forwards the trace, which is never stepped
+    MemorySystem ffwd;
+    if (!ffwd.init(ctrl_filename, dev_filenames, sizes)) return false;
+
+    // windows waiting for a thread, only a few of them are kept so the trace
+    //   is not read far ahead
+    if (num_jobs == 0) num_jobs = 1;
+    size_t max_waiting = 2 * num_jobs;
+    deque<SampleWindow *> waiting;
+    bool reading = true;
+    bool success = true;
+    vector<pair<size_t, SampleResult>> results;
+    mutex mtx;
+    condition_variable cv;
+
+    // every thread reuses one memory system for all its windows
+    auto work = [&]() {
+        MemorySystem membles;
+        WindowStats stats;
+        membles.set_sink(&stats);
+        bool ready = membles.init(ctrl_filename, dev_filenames, sizes);
+        unique_lock<mutex> lock(mtx);
+        while (true) {
+            while (waiting.empty() && reading) cv.wait(lock);
+            if (waiting.empty()) break;
+            SampleWindow *window = waiting.front();
+            waiting.pop_front();
+            cv.notify_all();
+            lock.unlock();
+            SampleResult result;
+            bool measured = ready && SimulateWindow(membles, stats, *window,
+                                                    warmup_, result);
+            size_t index = window->index;
+            delete window;
+            lock.lock();
+            if (measured) {
+                results.push_back(make_pair(index, result));
+            } else {
+                success = false;
+            }
+        }
+    };
+    vector<thread> threads;
+    for (uint32_t j = 0; j < num_jobs; ++j) threads.push_back(thread(work));
+
+    // the window sits at the end of its period
+    uint64_t window_begin = period_ - warmup_ - measure_;
+    uint64_t window_size = warmup_ + measure_;
+    size_t num_windows = 0;
+    SampleWindow *window = nullptr;
+    TraceRecord record;
+    while (reader->next(record)) {
+        // region markers are not requests
+        if (record.marker != NO_MARKER) continue;
+        if (num_records_ % period_ == window_begin) {
+            window = new SampleWindow;
+            window->index = num_windows++;
+            ffwd.GetOpenRows(window->rows);
+            window->records.reserve(window_size);
+        }
+        ffwd.warm(record.addr, record.len);
+        num_records_++;
+        if (!window) continue;
+        window->records.push_back(record);
+        if (window->records.size() < window_size) continue;
+        unique_lock<mutex> lock(mtx);
+        while (waiting.size() >= max_waiting) cv.wait(lock);
+        waiting.push_back(window);
+        cv.notify_all();
+        window = nullptr;
+    }
+    // a window cut short by the end of the trace is dropped
+    delete window;
+    {
+        lock_guard<mutex> lock(mtx);
+        reading = false;
+    }
+    cv.notify_all();
+    for (auto &t : threads) t.join();
+
+    // windows are done out of order
+    sort(results.begin(), results.end(),
+         [](const pair<size_t, SampleResult> &a,
+            const pair<size_t, SampleResult> &b) {
+             return a.first < b.first;
+         });
+    for (auto &result : results) results_.push_back(result.second);
+    if (results_.empty()) {
+        ERROR("The trace is too short to fill a sampling window.");
+        return false;
+    }
+    return success;
+}
+
+
+/*
+ * Print the estimates with their confidence intervals
+ */
+void Sampler::report(ostream &os) const
+{
+    vector<double> bandwidth, latency, row_hit_rate;
+    for (auto &result : results_) {
+        bandwidth.push_back(result.bandwidth);
+        latency.push_back(result.latency);
+        row_hit_rate.push_back(result.row_hit_rate);
+    }
+    const char *names[] = {
+        "Bandwidth (GB/s):   ", "Latency (cycles):   ", "Row-hit rate:       "
+    };
+    const vector<double> *samples[] = {&bandwidth, &latency, &row_hit_rate};
+
+    ios_base::fmtflags flags = os.flags();
+    streamsize precision = os.precision();
+    os << "   Records: " << num_records_ << ", windows: " << results_.size()
+       << " x (" << warmup_ << " warmup + " << measure_ << " measured) every "
+       << period_ << endl;
+    for (size_t i = 0; i < 3; ++i) {
+        double mean;
+        double half_width = Estimate(*samples[i], mean);
+        os << "   " << names[i] << fixed << setprecision(4) << mean << " +- "
+           << half_width << " (" << setprecision(2)
+           << (mean ? 100 * half_width / mean : 0) << "%)" << endl;
+    }
+    os << "   (95% confidence intervals)" << endl;
+    os.flags(flags);
+    os.precision(precision);
+}
+
+}
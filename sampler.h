@@ -0,0 +1,97 @@
+/* Copyright (c) 2014, Jue Wang
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <string>
+#include <vector>
+#include <ostream>
+
+#include "macro.h"
+#include "trace.h"
+
+namespace membles
+{
+
+/*
+ * What a window measures
+ */
+struct SampleResult {
+    // GB/s
+    double bandwidth;
+    // cycles between acceptance and retirement
+    double latency;
+    // fraction of transactions that need no activation
+    double row_hit_rate;
+};
+
+
+/*
+ * Sampled simulation in the manner of SMARTS: a trace is cut into periods of
+ *   a fixed number of records, and only a window at the end of each period is
+ *   simulated in detail. The rest of the period is fast-forwarded, where a
+ *   record only opens its row in the row buffer of its bank.
+ * A window starts from the row buffers left by the fast-forwarding and empty
+ *   queues, so its first records warm the queues up and only the records
+ *   after them are measured. Windows are independent of each other, and they
+ *   are simulated on a pool of threads while the trace is read ahead.
+ * Every metric is estimated by its mean over the windows, with a confidence
+ *   interval derived from the variance among the windows.
+ */
+class Sampler
+{
+
+  public:
+
+    // a window of warmup + measure records at the end of every period
+    Sampler(uint64_t period, uint64_t measure, uint64_t warmup);
+
+    bool run(const string &ctrl_filename,
+             const vector<string> &dev_filenames,
+             const vector<uint64_t> &sizes,
+             TraceReader *reader, uint32_t num_jobs);
+
+    void report(ostream &os) const;
+
+  private:
+
+    uint64_t period_;
+    uint64_t measure_;
+    uint64_t warmup_;
+
+    // results of the windows, in trace order
+    vector<SampleResult> results_;
+
+    // number of records read and fast-forwarded
+    uint64_t num_records_;
+
+};
+
+}
+
+#endif
@@ -31,26 +31,40 @@ namespace membles
 {
 
 /* ctor: Scheduler
- * Initialize address mapper and bank state table references
+ * Initialize bank state table reference
  */
-Scheduler::Scheduler(Channel *parent, AddressMap &mapper,
-                     vector<vector<Bank>> &banks)
+Scheduler::Scheduler(Channel *parent, vector<vector<Bank>> &banks)
     : parent_(parent),
-      mapper_(mapper),
+      cmd_pool_(nullptr),
+      cmd_count_(0),
+      num_cmd_(0),
+      issued_(false),
+      next_ready_(MAX_CYCLE),
+      next_index_(NO_BANK),
+      limit_valid_(false),
+      limit_(STALL_EMPTY),
       banks_(banks)
 {}
 
 
 /*
  * Initialize the scheduler
- * Resize the bank state table size
+ * Create one command queue per bank
  */
-bool Scheduler::init(CtrlCfg *ctrl_cfg, DevCfg *dev_cfg,
-                     ofstream *log, ofstream *csv, ofstream *trc)
+bool Scheduler::init(Pool<Command> *cmd_pool, CtrlCfg *ctrl_cfg,
+                     DevCfg *dev_cfg, ostream *log, ostream *csv,
+                     RecordSink *trc)
 {
     bool success = MemObj::init(ctrl_cfg, dev_cfg, log, csv, trc);
     if (!success) return false;
-    
+
+    cmd_pool_ = cmd_pool;
+
+    size_t num_queue = dev_cfg_->num_rank * dev_cfg_->num_bank;
+    cmd_queues_.resize(num_queue);
+    pending_.resize((num_queue + 63) / 64, 0);
+    ready_.resize(num_queue, MAX_CYCLE);
+
     return success;
 }
 
@@ -61,45 +75,52 @@ bool Scheduler::init(CtrlCfg *ctrl_cfg, DevCfg *dev_cfg,
 void Scheduler::step()
 {
     Command *cmd = schedule();
+    issued_ = cmd != nullptr;
     // if a command is ready to execute
     if (cmd) {
         if (verbose_) INFO("@" << cycle_ << ": Command issued: " << *cmd);
         if (trc_) {
-            *trc_ << "CH" << parent_->id() << " " << cycle_ << " ";
-            switch (cmd->type()) {
-            case READ:
-                *trc_ << "READ";
-                break;
-            case WRITE:
-                *trc_ << "WRITE";
-                break;
-            case ACTIVATE:
-                *trc_ << "ROWACT";
-                break;
-            case PRECHARGE:
-                *trc_ << "PRECHARGE";
-                break;
-            default:
-                *trc_ << "UNKNOWN";
-            }
-            *trc_ << " " << cmd->tx()->id() << " " << cmd->rank() << " "
-                << cmd->bank() << " " << cmd->row() << " " << cmd->col()
-                << endl;
+            CmdRecord record;
+            record.cycle = cycle_;
+            record.tx_id = cmd->tx()->id();
+            record.row = cmd->row();
+            record.col = cmd->col();
+            record.chan = parent_->id();
+            record.rank = cmd->rank();
+            record.bank = cmd->bank();
+            record.type = cmd->type();
+            record.reserved = 0;
+            trc_->command(record);
         }
 
         execute(cmd);
-        for (auto iter = cmd_queue_.begin(); iter != cmd_queue_.end(); ++iter) {
-            if (*iter == cmd) {
-                cmd_queue_.erase(iter);
-                break;
-            }
+        // the issued command must be the head of its queue
+        uint32_t index = cmd->rank() * dev_cfg_->num_bank + cmd->bank();
+        assert(cmd_queues_[index].front() == cmd);
+        cmd_queues_[index].pop_front();
+        num_cmd_--;
+        if (cmd_queues_[index].empty()) {
+            pending_[index / 64] &= ~(1UL << (index % 64));
         }
+        // the command might impact every bank in the same channel
+        UpdateReady();
+        cmd_pool_->destroy(cmd);
     }
 
     cycle_++;
 }
 
 
+/*
+ * Return the earliest cycle that a queued command becomes issuable
+ * Bank states are assumed to stay unchanged until then
+ */
+Cycle Scheduler::NextEvent() const
+{
+    return max(next_ready_, cycle_);
+}
+
+
 /*
  * Break a transaction into bus commands and add them into command queue
  * Return false if command queue lacks of space
@@ -125,39 +146,46 @@ bool Scheduler::AddTx(Transaction *tx, bool need_act, bool need_pre)
     if (need_pre) to_fill++;
     // double the size because we reserve an ACTIVATE for each READ/WRITE
     to_fill *= 2;
-    if (cmd_queue_.size() + to_fill > max_cmd_queue_depth_)
+    if (num_cmd_ + to_fill > max_cmd_queue_depth_)
         return false;
     
-    // decoding address
-    uint32_t chan, rank, bank, row, col;
-    mapper_.map(addr, chan, rank, bank, row, col);
+    // the address has been decoded when the channel accepted the transaction
+    uint32_t chan = tx->chan();
+    uint32_t rank = tx->rank();
+    uint32_t bank = tx->bank();
+    uint32_t row = tx->row();
+    uint32_t col = tx->col();
 
     if (need_pre) {
         // generate PERCHARGE command
-        PreCmd *pre = new PreCmd(cycle_, chan, rank, bank, priority, tx);
+        PreCmd *pre = cmd_pool_->create<PreCmd>(cmd_count_++, cycle_, chan,
+                                                rank, bank, priority, tx);
         if (verbose_) INFO("@" << cycle_ << ": Command added: " << *pre);
-        cmd_queue_.insert(pre);
+        enqueue(pre);
     }
 
     if (need_act) {
         // generate ACTIVATE command
-        ActCmd *act = new ActCmd(cycle_, chan, rank, bank, row,
-                                 priority, tx);
+        ActCmd *act = cmd_pool_->create<ActCmd>(cmd_count_++, cycle_, chan,
+                                                rank, bank, row, priority,
+                                                tx);
         if (verbose_) INFO("@" << cycle_ << ": Command added: " << *act);
-        cmd_queue_.insert(act);
+        enqueue(act);
     }
 
     // generate READ/WRITE command
     if (tx->is_read()) {
-        ReadCmd *rd = new ReadCmd(cycle_, chan, rank, bank, row, col,
-                                  priority, tx);
+        ReadCmd *rd = cmd_pool_->create<ReadCmd>(cmd_count_++, cycle_, chan,
+                                                 rank, bank, row, col,
+                                                 priority, tx);
         if (verbose_) INFO("@" << cycle_ << ": Command added: " << *rd);
-        cmd_queue_.insert(rd);
+        enqueue(rd);
     } else {
-        WriteCmd *wr = new WriteCmd(cycle_, chan, rank, bank, row, col,
-                                    priority, tx);
+        WriteCmd *wr = cmd_pool_->create<WriteCmd>(cmd_count_++, cycle_, chan,
+                                                   rank, bank, row, col,
+                                                   priority, tx);
         if (verbose_) INFO("Command added: " << *wr);
-        cmd_queue_.insert(wr);
+        enqueue(wr);
     }
 
     if (verbose_) {
@@ -170,55 +198,219 @@ bool Scheduler::AddTx(Transaction *tx, bool need_act, bool need_pre)
 
 /*
  * Schedule the next bus command
+ * Among the issuable queue heads, the one with the highest priority wins, and
+ *   the oldest one breaks a tie
  */
 Command *Scheduler::schedule()
 {
     // TODO consider open-page only
-    for (auto iter = cmd_queue_.begin(); iter != cmd_queue_.end(); ++iter) {
-        // the order is already maintained by STL set data structure
-        // traverse the command queue from begin to end
-        // return the first issuable command, and calculate the next scheduling
-        //   cycle
-        Command *this_cmd = *iter;
-        uint32_t rank = this_cmd->rank();
-        uint32_t bank = this_cmd->bank();
-        Bank &b = banks_[rank][bank];
-        if (b.next(this_cmd) <= cycle_) return this_cmd;
+    // nothing can be issued yet
+    if (next_ready_ > cycle_) return nullptr;
+
+    CmdCompare compare;
+    Command *selected = nullptr;
+    for (size_t w = 0; w < pending_.size(); ++w) {
+        uint64_t bits = pending_[w];
+        while (bits) {
+            uint32_t index = w * 64 + __builtin_ctzll(bits);
+            bits &= bits - 1;
+            if (ready_[index] > cycle_) continue;
+            Command *this_cmd = cmd_queues_[index].front();
+            if (!selected || compare(this_cmd, selected)) selected = this_cmd;
+        }
     }
 
-    return nullptr;
+    return selected;
 }
 
 
 /*
- * Execute a command, make impact to its associated banks
+ * Find what holds back the queue head that becomes issuable first
+ * The heads only change when a command is queued or issued, so the answer is
+ *   kept until then
+ */
+void Scheduler::UpdateLimit()
+{
+    limit_ = STALL_EMPTY;
+    if (next_index_ != NO_BANK) {
+        uint32_t num_bank = dev_cfg_->num_bank;
+        uint32_t i = next_index_;
+        Bank &b = banks_[i / num_bank][i % num_bank];
+        limit_ = b.limit(cmd_queues_[i].front(), next_ready_);
+    }
+    limit_valid_ = true;
+}
+
+
+/*
+ * Execute a command, make impact to its associated bank
+ * The rest of the rank and the channel see the impact through the shared
+ *   rank-level and channel-level timing
  */
 void Scheduler::execute(Command *cmd)
 {
-    uint32_t num_rank = dev_cfg_->num_rank;
+    banks_[cmd->rank()][cmd->bank()].operate(cmd, cycle_);
+    if (cmd->tx()->sampled()) parent_->stamp(cmd);
+    // release bank if work is done
+    if (cmd->type() == READ || cmd->type() == WRITE) {
+        parent_->process(cmd);
+    }
+}
+
+
+/*
+ * Forget everything but the configuration
+ */
+void Scheduler::reset()
+{
+    assert(num_cmd_ == 0);
+    cycle_ = 0;
+    cmd_count_ = 0;
+    issued_ = false;
+    fill(ready_.begin(), ready_.end(), MAX_CYCLE);
+    next_ready_ = MAX_CYCLE;
+    next_index_ = NO_BANK;
+    limit_valid_ = false;
+}
+
+
+/*
+ * Save the command queues in order
+ */
+void Scheduler::save(CheckpointWriter &out) const
+{
+    out.put(cycle_);
+    out.put(cmd_count_);
+    out.put(num_cmd_);
+    for (auto &queue : cmd_queues_) {
+        for (auto cmd : queue) {
+            // every queued command belongs to a dispatched transaction
+            assert(cmd->tx());
+            out.put(cmd->id());
+            out.put(cmd->birth_cycle());
+            out.put(cmd->type());
+            out.put(cmd->rank());
+            out.put(cmd->bank());
+            out.put(cmd->row());
+            out.put(cmd->col());
+            out.put(cmd->priority());
+            out.put(cmd->tx()->is_read());
+            out.put(cmd->tx()->slot());
+        }
+    }
+}
+
+
+/*
+ * Rebuild the command queues saved by save(), the banks must have been
+ *   restored already
+ * Return false if the commands do not fit the queue
+ */
+bool Scheduler::restore(CheckpointReader &in,
+                        const vector<Transaction *> &rd_resp,
+                        const vector<Transaction *> &wr_resp)
+{
+    assert(num_cmd_ == 0);
+    cycle_ = in.get();
+    cmd_count_ = in.get();
+    size_t num_cmd = in.get();
+    if (num_cmd > max_cmd_queue_depth_) {
+        ERROR(in.filename() << " holds " << num_cmd << " commands, more than "
+              "the command queue depth " << max_cmd_queue_depth_ << ".");
+        return false;
+    }
+    uint32_t chan = parent_->id();
+    for (size_t i = 0; i < num_cmd && in.good(); ++i) {
+        uint64_t id = in.get();
+        Cycle birth_cycle = in.get();
+        CmdType type = (CmdType)in.get();
+        uint32_t rank = in.get();
+        uint32_t bank = in.get();
+        uint32_t row = in.get();
+        uint32_t col = in.get();
+        uint16_t priority = in.get();
+        const vector<Transaction *> &resp = in.get() ? rd_resp : wr_resp;
+        size_t slot = in.get();
+        if (rank >= dev_cfg_->num_rank || bank >= dev_cfg_->num_bank ||
+                slot >= resp.size()) {
+            ERROR(in.filename() << " has a command out of range.");
+            return false;
+        }
+        Transaction *tx = resp[slot];
+        Command *cmd = nullptr;
+        switch (type) {
+        case PRECHARGE:
+            cmd = cmd_pool_->create<PreCmd>(id, birth_cycle, chan, rank, bank,
+                                            priority, tx);
+            break;
+        case ACTIVATE:
+            cmd = cmd_pool_->create<ActCmd>(id, birth_cycle, chan, rank, bank,
+                                            row, priority, tx);
+            break;
+        case READ:
+        case READ_AP:
+            cmd = cmd_pool_->create<ReadCmd>(id, birth_cycle, chan, rank,
+                                             bank, row, col, priority, tx,
+                                             type == READ_AP);
+            break;
+        case WRITE:
+        case WRITE_AP:
+            cmd = cmd_pool_->create<WriteCmd>(id, birth_cycle, chan, rank,
+                                              bank, row, col, priority, tx,
+                                              type == WRITE_AP);
+            break;
+        default:
+            ERROR(in.filename() << " has a command of unknown type "
+                  << (uint32_t)type << ".");
+            return false;
+        }
+        enqueue(cmd);
+    }
+    return in.good();
+}
+
+
+/*
+ * Append a command to the queue of its bank
+ */
+void Scheduler::enqueue(Command *cmd)
+{
+    uint32_t index = cmd->rank() * dev_cfg_->num_bank + cmd->bank();
+    deque<Command *> &queue = cmd_queues_[index];
+    queue.push_back(cmd);
+    num_cmd_++;
+    if (queue.size() == 1) {
+        // a new queue head
+        pending_[index / 64] |= 1UL << (index % 64);
+        ready_[index] = banks_[cmd->rank()][cmd->bank()].next(cmd);
+        if (ready_[index] < next_ready_ || next_index_ == NO_BANK) {
+            next_ready_ = ready_[index];
+            next_index_ = index;
+        }
+        limit_valid_ = false;
+    }
+}
+
+
+/*
+ * Recalculate the ready cycle of every queue head
+ */
+void Scheduler::UpdateReady()
+{
     uint32_t num_bank = dev_cfg_->num_bank;
-    uint32_t rank = cmd->rank();
-    uint32_t bank = cmd->bank();
-    // all the banks on the same channel (different or same ranks) might be
-    //   impacted by this command
-    for (uint32_t r = 0; r < num_rank; ++r) {
-        for (uint32_t b = 0; b < num_bank; ++b) {
-            if (r != rank) {
-                // different rank
-                banks_[r][b].operate(cmd, false, false);
-            } else {
-                // same rank
-                if (b != bank) {
-                    // different bank
-                    banks_[r][b].operate(cmd, false, true);
-                } else {
-                    // same bank
-                    banks_[r][b].operate(cmd, true, true);
-                    // release bank if work is done
-                    if (cmd->type() == READ || cmd->type() == WRITE) {
-                        parent_->process(cmd);
-                    }
-                }
+    next_ready_ = MAX_CYCLE;
+    next_index_ = NO_BANK;
+    limit_valid_ = false;
+    for (size_t w = 0; w < pending_.size(); ++w) {
+        uint64_t bits = pending_[w];
+        while (bits) {
+            uint32_t index = w * 64 + __builtin_ctzll(bits);
+            bits &= bits - 1;
+            Bank &b = banks_[index / num_bank][index % num_bank];
+            ready_[index] = b.next(cmd_queues_[index].front());
+            if (ready_[index] < next_ready_ || next_index_ == NO_BANK) {
+                next_ready_ = ready_[index];
+                next_index_ = index;
             }
         }
     }
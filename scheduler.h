@@ -27,12 +27,14 @@
 #ifndef SCHEDULER_H
 #define SCHEDULER_H
 
-#include <set>
+#include <vector>
+#include <deque>
 
 #include "base_obj.h"
-#include "address_map.h"
 #include "command.h"
 #include "bank.h"
+#include "pool.h"
+#include "checkpoint.h"
 
 namespace membles
 {
@@ -44,21 +46,42 @@ class Scheduler : public MemObj
 
   public:
    
-    Scheduler(Channel *parent, AddressMap &mapper, vector<vector<Bank>> &bank);
+    Scheduler(Channel *parent, vector<vector<Bank>> &bank);
 
-    bool init(CtrlCfg *ctrl_cfg, DevCfg *dev_cfg,
-              ofstream *log, ofstream *csv, ofstream *trc);
+    bool init(Pool<Command> *cmd_pool, CtrlCfg *ctrl_cfg, DevCfg *dev_cfg,
+              ostream *log, ostream *csv, RecordSink *trc);
 
     void step();
+    // whether the last step issued a command
+    bool issued() const { return issued_; }
+
+    Cycle NextEvent() const;
 
     bool AddTx(Transaction *tx, bool need_act = false, bool need_pre = false);
 
     Command *schedule();
 
+    // what holds up the command bus while nothing is issuable, and the queue
+    //   (rank * num_bank + bank) that becomes issuable first, or STALL_EMPTY
+    //   and NO_BANK if no command is queued
+    StallCause limit(uint32_t &index) {
+        if (!limit_valid_) UpdateLimit();
+        index = next_index_;
+        return limit_;
+    }
+
     void execute(Command *cmd);
 
     void SetCmdQueueDepth(uint32_t max_cmd_queue_depth);
 
+    // go back to cycle 0, the command queues must be empty
+    void reset();
+
+    // commands refer to their transactions by response queue slot
+    void save(CheckpointWriter &out) const;
+    bool restore(CheckpointReader &in, const vector<Transaction *> &rd_resp,
+                 const vector<Transaction *> &wr_resp);
+
   private:
 
     // pointer to its parent channel
@@ -67,17 +90,39 @@ class Scheduler : public MemObj
     // command queue depth
     uint32_t max_cmd_queue_depth_;
 
-    // command queue
-    // using STL set instead of STL vector because we want to maintain the 
-    //   command order at any time
-    set<Command *, CmdCompare> cmd_queue_;
+    // command allocator (owned by the memory system)
+    Pool<Command> *cmd_pool_;
+    // number of commands created so far, which numbers the next command
+    // commands are only compared within a scheduler, so the IDs do not need
+    //   to be unique across channels
+    uint64_t cmd_count_;
+
+    // command queues, one FIFO per bank indexed by rank * num_bank + bank
+    // commands of a bank have to be issued in order (e.g. PRE, ACT, READ), so
+    //   only the head of each queue is a candidate
+    vector<deque<Command *>> cmd_queues_;
+    // total number of queued commands
+    size_t num_cmd_;
+    bool issued_;
+
+    // bitmap of banks whose command queue is not empty
+    vector<uint64_t> pending_;
+    // the earliest cycle that the head of each queue becomes issuable
+    vector<Cycle> ready_;
+    // the earliest ready cycle over all queues, and the first queue with it
+    Cycle next_ready_;
+    uint32_t next_index_;
+    // limit() of the current queue heads, valid until they change
+    bool limit_valid_;
+    StallCause limit_;
 
-    // address mapper reference
-    AddressMap &mapper_;
-    
     // bank state table reference
     vector<vector<Bank>> &banks_;
 
+    void enqueue(Command *cmd);
+    void UpdateReady();
+    void UpdateLimit();
+
 };
 
 }
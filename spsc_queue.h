@@ -0,0 +1,127 @@
+/* Copyright (c) 2014, Jue Wang
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <vector>
+#include <atomic>
+
+#include "macro.h"
+
+namespace membles
+{
+
+/*
+ * A bounded lock-free queue with exactly one producer thread and one
+ *   consumer thread
+ * The capacity is rounded up to a power of 2. The two indices only grow and
+ *   sit on separate cache lines, so the threads do not bounce a line on every
+ *   push and pop.
+ */
+template <class T>
+class SpscQueue
+{
+
+  public:
+
+    SpscQueue()
+        : mask_(0),
+          head_(0),
+          tail_(0)
+    {}
+
+    // set the capacity, must be called before the queue is shared
+    void init(size_t capacity)
+    {
+        size_t size = 1;
+        while (size < capacity) size <<= 1;
+        buf_.resize(size);
+        mask_ = size - 1;
+        head_.store(0, memory_order_relaxed);
+        tail_.store(0, memory_order_relaxed);
+    }
+
+    // producer: append an item, return false if the queue is full
+    bool push(const T &item)
+    {
+        size_t tail = tail_.load(memory_order_relaxed);
+        if (tail - head_.load(memory_order_acquire) > mask_) return false;
+        buf_[tail & mask_] = item;
+        tail_.store(tail + 1, memory_order_release);
+        return true;
+    }
+
+    // consumer: peek at the oldest item, return nullptr if the queue is empty
+    // the item stays valid until pop()
+    const T *front() const
+    {
+        size_t head = head_.load(memory_order_relaxed);
+        if (head == tail_.load(memory_order_acquire)) return nullptr;
+        return &(buf_[head & mask_]);
+    }
+
+    // consumer: remove the oldest item, return false if the queue is empty
+    bool pop(T &item)
+    {
+        const T *head_item = front();
+        if (!head_item) return false;
+        item = *head_item;
+        pop();
+        return true;
+    }
+
+    // consumer: remove the oldest item, which must exist
+    void pop()
+    {
+        head_.store(head_.load(memory_order_relaxed) + 1,
+                    memory_order_release);
+    }
+
+    // either side: whether everything pushed so far has been popped
+    bool empty() const
+    {
+        return head_.load(memory_order_acquire) ==
+                tail_.load(memory_order_acquire);
+    }
+
+  private:
+
+    vector<T> buf_;
+    size_t mask_;
+
+    // consumer index
+    atomic<size_t> head_;
+    char pad_[64];
+    // producer index
+    atomic<size_t> tail_;
+
+};
+
+}
+
+#endif
@@ -0,0 +1,365 @@
+/* Copyright (c) 2014, Jue Wang
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <cmath>
+#include <algorithm>
+
+#include "stats.h"
+#include "output.h"
+
+namespace membles
+{
+
+/* ctor: Histogram
+ * Every bucket a 64-bit value can fall in is allocated up front
+ */
+Histogram::Histogram()
+    : counts_(index(UINT64_MAX) + 1, 0),
+      count_(0),
+      sum_(0),
+      max_(0)
+{}
+
+
+/*
+ * Add the values of another histogram
+ */
+void Histogram::merge(const Histogram &other)
+{
+    for (size_t i = 0; i < counts_.size(); ++i) counts_[i] += other.counts_[i];
+    count_ += other.count_;
+    sum_ += other.sum_;
+    max_ = std::max(max_, other.max_);
+}
+
+
+/*
+ * Forget every value
+ */
+void Histogram::reset()
+{
+    fill(counts_.begin(), counts_.end(), 0);
+    count_ = 0;
+    sum_ = 0;
+    max_ = 0;
+}
+
+
+/*
+ * Return the largest value of the bucket holding the given fraction of the
+ *   values, which is never beyond the largest value recorded
+ */
+Cycle Histogram::percentile(double fraction) const
+{
+    if (!count_) return 0;
+    uint64_t target = (uint64_t)ceil(fraction * count_);
+    if (target == 0) target = 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts_.size(); ++i) {
+        seen += counts_[i];
+        if (seen >= target) return std::min(highest(i), max_);
+    }
+    return max_;
+}
+
+
+/*
+ * Return the largest value that falls in a bucket
+ */
+Cycle Histogram::highest(size_t index)
+{
+    const size_t half = 1ULL << (SUB_BITS - 1);
+    if (index < 2 * half) return index;
+    uint32_t shift = index / half - 1;
+    Cycle lowest = (Cycle)(index - shift * half) << shift;
+    return lowest + ((1ULL << shift) - 1);
+}
+
+
+/*
+ * Write the histogram as one JSON object
+ */
+void Histogram::report(ostream &os) const
+{
+    os << "{\"count\": " << count_ << ", \"mean\": " << mean()
+       << ", \"p50\": " << percentile(0.5)
+       << ", \"p99\": " << percentile(0.99)
+       << ", \"p99.9\": " << percentile(0.999)
+       << ", \"max\": " << max_ << "}";
+}
+
+
+/*
+ * Add the counters of another bank
+ */
+void BankStats::add(const BankStats &other)
+{
+    num_rd += other.num_rd;
+    num_wr += other.num_wr;
+    for (int i = 0; i < 3; ++i) num_outcome[i] += other.num_outcome[i];
+    busy_cycles += other.busy_cycles;
+    for (int i = 0; i < NUM_STALL; ++i) stalls[i] += other.stalls[i];
+}
+
+
+/*
+ * Write the counters as the members of a JSON object, given the cycles
+ *   measured times the number of banks counted
+ */
+void BankStats::report(ostream &os, Cycle cycles) const
+{
+    uint64_t num_tx = num_outcome[ROW_HIT] + num_outcome[ROW_MISS] +
+                      num_outcome[ROW_CONFLICT];
+    os << "\"reads\": " << num_rd << ", \"writes\": " << num_wr
+       << ", \"row_hits\": " << num_outcome[ROW_HIT]
+       << ", \"row_misses\": " << num_outcome[ROW_MISS]
+       << ", \"row_conflicts\": " << num_outcome[ROW_CONFLICT];
+    const char *rates[] = {"row_hit_rate", "row_miss_rate",
+                           "row_conflict_rate"};
+    for (int i = 0; i < 3; ++i) {
+        os << ", \"" << rates[i] << "\": "
+           << (num_tx ? (double)num_outcome[i] / num_tx : 0);
+    }
+    os << ", \"busy_cycles\": " << busy_cycles << ", \"busy_fraction\": "
+       << (cycles ? (double)busy_cycles / cycles : 0);
+}
+
+
+/*
+ * Write the stage histograms as one member named "lifecycle"
+ * The preparation of the bank runs from the dispatch to the column command,
+ *   and the bus time is the data stage
+ */
+void ReportLifecycle(ostream &os, const vector<Histogram> &stages)
+{
+    const char *names[NUM_STAGE] = {
+        "queue", "precharge", "activate", "column", "data", "total"
+    };
+    double sums[NUM_STAGE];
+    for (int i = 0; i < NUM_STAGE; ++i) sums[i] = stages[i].sum();
+    double total = sums[STAGE_TOTAL];
+    double prepare = sums[STAGE_PRECHARGE] + sums[STAGE_ACTIVATE] +
+                     sums[STAGE_COLUMN];
+    os << "\"lifecycle\": {\"sampled\": " << stages[STAGE_TOTAL].count();
+    for (int i = 0; i < NUM_STAGE; ++i) {
+        os << ",\n       \"" << names[i] << "\": ";
+        stages[i].report(os);
+    }
+    os << ",\n       \"share\": {\"queueing\": "
+       << (total ? sums[STAGE_QUEUE] / total : 0)
+       << ", \"preparation\": " << (total ? prepare / total : 0)
+       << ", \"bus\": " << (total ? sums[STAGE_DATA] / total : 0) << "}}";
+}
+
+
+/*
+ * Write the stall counters as one member named "stalls"
+ */
+void ReportStalls(ostream &os, const uint64_t *stalls, bool with_empty)
+{
+    const char *names[NUM_STALL] = {
+        "empty", "queue_full", "bank_in_use", "tRCD", "tRP", "tRAS",
+        "tRTP_tWR", "tCCD", "turnaround", "tRRD"
+    };
+    os << "\"stalls\": {";
+    for (int i = with_empty ? 0 : 1; i < NUM_STALL; ++i) {
+        os << (i > !with_empty ? ", " : "") << "\"" << names[i] << "\": "
+           << stalls[i];
+    }
+    os << "}";
+}
+
+
+/* ctor: Channel Statistics
+ * init() must be called to set up the banks
+ */
+ChanStats::ChanStats()
+    : num_rank_(0),
+      num_bank_(0),
+      since_(0),
+      rd_bytes_(0),
+      wr_bytes_(0),
+      rd_queue_sum_(0),
+      wr_queue_sum_(0),
+      rd_queue_max_(0),
+      wr_queue_max_(0),
+      num_cmd_(0),
+      stalls_(),
+      epoch_()
+{}
+
+
+/*
+ * Allocate the counters of every bank, and the stage histograms if asked to
+ */
+void ChanStats::init(uint32_t num_rank, uint32_t num_bank, bool sample)
+{
+    num_rank_ = num_rank;
+    num_bank_ = num_bank;
+    banks_.resize(num_rank * num_bank);
+    if (sample) stages_.resize(NUM_STAGE);
+    reset(0);
+}
+
+
+/*
+ * Clear every counter, the banks count as idle from a cycle on
+ */
+void ChanStats::reset(Cycle cycle)
+{
+    since_ = cycle;
+    rd_latency_.reset();
+    wr_latency_.reset();
+    rd_bytes_ = 0;
+    wr_bytes_ = 0;
+    for (auto &bank : banks_) {
+        bank = BankStats();
+        bank.busy_since = cycle;
+    }
+    rd_queue_sum_ = 0;
+    wr_queue_sum_ = 0;
+    rd_queue_max_ = 0;
+    wr_queue_max_ = 0;
+    num_cmd_ = 0;
+    fill(stalls_, stalls_ + NUM_STALL, 0);
+    for (auto &stage : stages_) stage.reset();
+    epoch_ = EpochCounters();
+}
+
+
+/*
+ * Record the stages of a sampled transaction
+ */
+void ChanStats::sample(const Lifecycle &life, Cycle done)
+{
+    Cycle arrive = life.tx->arrive_cycle();
+    stages_[STAGE_QUEUE].record(life.dispatch - arrive);
+    Cycle from = life.dispatch;
+    if (life.pre != MAX_CYCLE) {
+        stages_[STAGE_PRECHARGE].record(life.pre - from);
+        from = life.pre;
+    }
+    if (life.act != MAX_CYCLE) {
+        stages_[STAGE_ACTIVATE].record(life.act - from);
+        from = life.act;
+    }
+    stages_[STAGE_COLUMN].record(life.col - from);
+    stages_[STAGE_DATA].record(done - life.col);
+    stages_[STAGE_TOTAL].record(done - arrive);
+}
+
+
+/*
+ * Sum up the current epoch, bandwidth in GB/s given the controller frequency
+ *   in MHz
+ */
+void ChanStats::TakeEpoch(EpochRecord &record, Cycle start, Cycle end,
+                          Frequency freq)
+{
+    Cycle cycles = end - start;
+    uint64_t num_tx = epoch_.num_rd + epoch_.num_wr;
+    record.start_cycle = start;
+    record.end_cycle = end;
+    record.num_rd = epoch_.num_rd;
+    record.num_wr = epoch_.num_wr;
+    record.bandwidth = cycles ? (double)epoch_.bytes / cycles * freq / 1e3 : 0;
+    record.avg_latency = num_tx ? (double)epoch_.latency_sum / num_tx : 0;
+    record.max_latency = epoch_.latency_max;
+    record.row_hit_rate = epoch_.num_dispatch ?
+        (double)epoch_.num_hit / epoch_.num_dispatch : 0;
+    record.rd_queue = cycles ? (double)epoch_.rd_queue_sum / cycles : 0;
+    record.wr_queue = cycles ? (double)epoch_.wr_queue_sum / cycles : 0;
+    record.drain_cycles = epoch_.drain_cycles;
+    epoch_ = EpochCounters();
+}
+
+
+/*
+ * Add up the counters of every bank
+ */
+BankStats ChanStats::total() const
+{
+    BankStats total = BankStats();
+    for (auto &bank : banks_) total.add(bank);
+    return total;
+}
+
+
+/*
+ * Write the statistics as the members of a JSON object, one line per rank
+ *   and per bank
+ */
+void ChanStats::report(ostream &os, Cycle cycles, Frequency freq,
+                       double peak) const
+{
+    // byte per cycle to GB/s
+    double bandwidth = cycles ? (double)bytes() / cycles * freq / 1e3 : 0;
+    os << "\"bandwidth\": " << bandwidth << ", \"peak_bandwidth\": " << peak
+       << ", \"utilization\": " << (peak ? bandwidth / peak : 0) << ",\n";
+    os << "     \"read_latency\": ";
+    rd_latency_.report(os);
+    os << ",\n     \"write_latency\": ";
+    wr_latency_.report(os);
+    os << ",\n     ";
+    total().report(os, cycles * banks_.size());
+    os << ",\n     \"read_queue\": {\"mean\": "
+       << (cycles ? (double)rd_queue_sum_ / cycles : 0)
+       << ", \"max\": " << rd_queue_max_ << "}"
+       << ", \"write_queue\": {\"mean\": "
+       << (cycles ? (double)wr_queue_sum_ / cycles : 0)
+       << ", \"max\": " << wr_queue_max_ << "},\n     ";
+    os << "\"commands\": " << num_cmd_ << ", ";
+    ReportStalls(os, stalls_, true);
+    if (!stages_.empty()) {
+        os << ",\n     ";
+        ReportLifecycle(os, stages_);
+    }
+    os << ",\n     \"ranks\": [";
+    for (uint32_t r = 0; r < num_rank_; ++r) {
+        BankStats rank = BankStats();
+        for (uint32_t b = 0; b < num_bank_; ++b) {
+            rank.add(banks_[r * num_bank_ + b]);
+        }
+        os << (r ? "," : "") << "\n      {\"rank\": " << r << ", ";
+        rank.report(os, cycles * num_bank_);
+        os << ", ";
+        ReportStalls(os, rank.stalls, false);
+        os << ", \"banks\": [";
+        for (uint32_t b = 0; b < num_bank_; ++b) {
+            const BankStats &bank = banks_[r * num_bank_ + b];
+            os << (b ? "," : "") << "\n        {\"bank\": " << b << ", ";
+            bank.report(os, cycles);
+            os << ", ";
+            ReportStalls(os, bank.stalls, false);
+            os << "}";
+        }
+        os << "]}";
+    }
+    os << "]";
+}
+
+}
@@ -0,0 +1,309 @@
+/* Copyright (c) 2014, Jue Wang
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <vector>
+#include <ostream>
+
+#include "macro.h"
+#include "transaction.h"
+
+namespace membles
+{
+
+struct EpochRecord;
+
+/*
+ * A histogram of cycle counts with logarithmic buckets, in the manner of
+ *   HdrHistogram
+ * Every value below 2^SUB_BITS has a bucket of its own, and every power of 2
+ *   above is split into 2^(SUB_BITS - 1) buckets, so a value is known to
+ *   within 1/2^(SUB_BITS - 1) of itself. Recording is one increment.
+ */
+class Histogram
+{
+
+  public:
+
+    Histogram();
+
+    void record(Cycle value) {
+        counts_[index(value)]++;
+        count_++;
+        sum_ += value;
+        if (value > max_) max_ = value;
+    }
+    void merge(const Histogram &other);
+    void reset();
+
+    uint64_t count() const { return count_; }
+    uint64_t sum() const { return sum_; }
+    double mean() const { return count_ ? (double)sum_ / count_ : 0; }
+    Cycle max() const { return max_; }
+    // the value a fraction of the values are no larger than, 0 if empty
+    Cycle percentile(double fraction) const;
+
+    // one JSON object with the count, mean, p50, p99, p99.9 and max
+    void report(ostream &os) const;
+
+  private:
+
+    static const uint32_t SUB_BITS = 7;
+
+    vector<uint64_t> counts_;
+    uint64_t count_;
+    uint64_t sum_;
+    Cycle max_;
+
+    static size_t index(Cycle value) {
+        if (value < (1ULL << SUB_BITS)) return value;
+        uint32_t shift = 64 - __builtin_clzll(value) - SUB_BITS;
+        return ((size_t)shift << (SUB_BITS - 1)) + (value >> shift);
+    }
+    // the largest value sharing a bucket
+    static Cycle highest(size_t index);
+
+};
+
+
+// what a transaction finds in the row buffer of its bank
+enum RowOutcome {
+    ROW_HIT,
+    ROW_MISS,
+    ROW_CONFLICT
+};
+
+
+// what holds up the command bus in a cycle it issues nothing
+enum StallCause {
+    STALL_EMPTY,        // no command queued
+    STALL_QUEUE_FULL,   // a transaction waits for room in the command queue
+    STALL_BANK_IN_USE,  // every waiting transaction targets a bank in use
+    STALL_TRCD,
+    STALL_TRP,          // tRC included
+    STALL_TRAS,
+    STALL_TRTP_TWR,     // read or write to precharge
+    STALL_TCCD,
+    STALL_TURNAROUND,   // read-to-write, write-to-read and rank-to-rank
+    STALL_TRRD,
+    NUM_STALL
+};
+
+// the stalls held up by no bank in particular
+const uint32_t NO_BANK = UINT32_MAX;
+
+// the members of a JSON object, one per cause, STALL_EMPTY left out unless
+//   asked for
+void ReportStalls(ostream &os, const uint64_t *stalls, bool with_empty);
+
+
+// the stages of a transaction, each from the end of the one before
+enum LifeStage {
+    STAGE_QUEUE,        // accepted to dispatched to the scheduler
+    STAGE_PRECHARGE,    // to the PRE, row conflicts only
+    STAGE_ACTIVATE,     // to the ACT, row misses and conflicts only
+    STAGE_COLUMN,       // to the READ or WRITE
+    STAGE_DATA,         // to the end of the data burst
+    STAGE_TOTAL,        // accepted to the end of the data burst
+    NUM_STAGE
+};
+
+
+/*
+ * The timestamps of a sampled transaction in flight, MAX_CYCLE for a command
+ *   it does not need or is yet to issue
+ */
+struct Lifecycle {
+    Transaction *tx;
+    Cycle dispatch;
+    Cycle pre;
+    Cycle act;
+    Cycle col;
+};
+
+// the members of a JSON object with a histogram per stage and the share of
+//   the total spent queueing, preparing the bank and on the bus
+void ReportLifecycle(ostream &os, const vector<Histogram> &stages);
+
+
+/*
+ * Counters of a bank
+ */
+struct BankStats {
+    uint64_t num_rd;
+    uint64_t num_wr;
+    uint64_t num_outcome[3];
+    // cycles the bank is in use by a transaction, from its dispatch to its
+    //   last column command
+    Cycle busy_cycles;
+    Cycle busy_since;
+    // idle command bus cycles held up by the bank
+    uint64_t stalls[NUM_STALL];
+
+    void add(const BankStats &other);
+    void report(ostream &os, Cycle cycles) const;
+};
+
+
+/*
+ * Statistics of a channel, updated as it goes
+ * Latency runs from the acceptance of a transaction to its retirement, and
+ *   the queue occupancy is averaged over every cycle, skipped ones
+ *   included. Banks are indexed by rank * num_bank + bank, and a rank is the
+ *   sum of its banks.
+ * Every cycle the command bus is idle is charged to a cause, and to the bank
+ *   that holds it up if any, so the stalls and the commands issued add up to
+ *   the cycles since the last reset.
+ * A few of the counters are also kept for the current epoch, which
+ *   TakeEpoch() turns into a record and starts over.
+ */
+class ChanStats
+{
+
+  public:
+
+    ChanStats();
+
+    // the stage histograms are only there if transactions are sampled
+    void init(uint32_t num_rank, uint32_t num_bank, bool sample);
+    // forget everything, counting from a cycle on
+    void reset(Cycle cycle);
+
+    void dispatch(const Transaction *tx, RowOutcome outcome, Cycle cycle) {
+        BankStats &bank = banks_[tx->rank() * num_bank_ + tx->bank()];
+        (tx->is_read() ? bank.num_rd : bank.num_wr)++;
+        bank.num_outcome[outcome]++;
+        bank.busy_since = cycle;
+        epoch_.num_dispatch++;
+        if (outcome == ROW_HIT) epoch_.num_hit++;
+    }
+    void release(uint32_t rank, uint32_t bank, Cycle cycle) {
+        BankStats &stats = banks_[rank * num_bank_ + bank];
+        stats.busy_cycles += cycle - stats.busy_since;
+    }
+    void retire(const Transaction *tx, Cycle cycle) {
+        Cycle latency = cycle - tx->arrive_cycle();
+        if (tx->is_read()) {
+            rd_latency_.record(latency);
+            rd_bytes_ += tx->len();
+        } else {
+            wr_latency_.record(latency);
+            wr_bytes_ += tx->len();
+        }
+        (tx->is_read() ? epoch_.num_rd : epoch_.num_wr)++;
+        epoch_.bytes += tx->len();
+        epoch_.latency_sum += latency;
+        if (latency > epoch_.latency_max) epoch_.latency_max = latency;
+    }
+    // the queues hold some transactions for some cycles
+    void occupy(size_t num_rd, size_t num_wr, bool draining, Cycle cycles) {
+        rd_queue_sum_ += num_rd * cycles;
+        wr_queue_sum_ += num_wr * cycles;
+        if (num_rd > rd_queue_max_) rd_queue_max_ = num_rd;
+        if (num_wr > wr_queue_max_) wr_queue_max_ = num_wr;
+        epoch_.rd_queue_sum += num_rd * cycles;
+        epoch_.wr_queue_sum += num_wr * cycles;
+        if (draining) epoch_.drain_cycles += cycles;
+    }
+    // a sampled transaction finishes its data burst at a cycle
+    void sample(const Lifecycle &life, Cycle done);
+    // a command is issued
+    void issue() { num_cmd_++; }
+    // the command bus is idle for some cycles
+    void stall(StallCause cause, uint32_t index, Cycle cycles) {
+        stalls_[cause] += cycles;
+        if (index != NO_BANK) banks_[index].stalls[cause] += cycles;
+    }
+    // fill in the record of the epoch ending at a cycle, but the channel,
+    //   and start the next one
+    void TakeEpoch(EpochRecord &record, Cycle start, Cycle end,
+                   Frequency freq);
+
+    const Histogram &rd_latency() const { return rd_latency_; }
+    const Histogram &wr_latency() const { return wr_latency_; }
+    uint64_t bytes() const { return rd_bytes_ + wr_bytes_; }
+    Cycle since() const { return since_; }
+    uint64_t num_cmd() const { return num_cmd_; }
+    const uint64_t *stalls() const { return stalls_; }
+    const vector<Histogram> &stages() const { return stages_; }
+    // the counters of every bank added up
+    BankStats total() const;
+
+    // the body of a JSON object, given the cycles measured, the controller
+    //   frequency in MHz and the peak bandwidth in GB/s
+    void report(ostream &os, Cycle cycles, Frequency freq,
+                double peak) const;
+
+  private:
+
+    uint32_t num_rank_;
+    uint32_t num_bank_;
+
+    // the cycle the counters start from
+    Cycle since_;
+
+    Histogram rd_latency_;
+    Histogram wr_latency_;
+    uint64_t rd_bytes_;
+    uint64_t wr_bytes_;
+
+    vector<BankStats> banks_;
+
+    // occupancy of the read and write queues summed over cycles
+    uint64_t rd_queue_sum_;
+    uint64_t wr_queue_sum_;
+    size_t rd_queue_max_;
+    size_t wr_queue_max_;
+
+    // commands issued, and idle command bus cycles by cause
+    uint64_t num_cmd_;
+    uint64_t stalls_[NUM_STALL];
+
+    // the lifecycles of the sampled transactions, one histogram per stage
+    vector<Histogram> stages_;
+
+    // counters of the current epoch
+    struct EpochCounters {
+        uint64_t num_rd;
+        uint64_t num_wr;
+        uint64_t bytes;
+        Cycle latency_sum;
+        Cycle latency_max;
+        uint64_t num_dispatch;
+        uint64_t num_hit;
+        uint64_t rd_queue_sum;
+        uint64_t wr_queue_sum;
+        Cycle drain_cycles;
+    } epoch_;
+
+};
+
+}
+
+#endif
@@ -0,0 +1,273 @@
+/* Copyright (c) 2014, Jue Wang
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <atomic>
+
+#include "sweep.h"
+#include "controller_config.h"
+#include "device_config.h"
+#include "memory_system.h"
+#include "driver.h"
+
+namespace membles
+{
+
+/* ctor: Sweep
+ * Runs write no records by default
+ */
+Sweep::Sweep()
+    : binary_output_(false),
+      num_warmup_(0),
+      roi_(false),
+      fast_(false)
+{}
+
+
+/*
+ * Read a sweep file
+ * Every key must be a parameter of either the controller configuration or
+ *   the device configuration
+ */
+bool Sweep::ReadFile(const string &filename)
+{
+    INFO("Read sweep description from <" << filename << "> ...");
+    ifstream file;
+    file.open(filename.c_str());
+    if (!file.is_open()) {
+        ERROR("Cannot open file " << filename << ".");
+        return false;
+    }
+    // configurations that tell which keys are valid
+    CtrlCfg ctrl_cfg;
+    DevCfg dev_cfg;
+    string line;
+    while (getline(file, line)) {
+        // remove comment
+        size_t comment_pos = line.find('#');
+        if (comment_pos != string::npos) {
+            line.erase(comment_pos);
+        }
+        // remove whitespace
+        line.erase(remove_if(line.begin(), line.end(), ::isspace), line.end());
+        // skip empty line
+        if (line.length() == 0) continue;
+        // split line into parameter name and values
+        size_t equal_pos = line.find('=');
+        if (equal_pos == string::npos) {
+            ERROR("Line \'" << line << "\' misses \'=\'");
+            return false;
+        }
+        string key = to_upper(line.substr(0, equal_pos));
+        if (!ctrl_cfg.has(key) && !dev_cfg.has(key)) {
+            ERROR(key << " is not a valid parameter name.");
+            return false;
+        }
+        if (find(keys_.begin(), keys_.end(), key) != keys_.end()) {
+            ERROR(key << " is swept more than once.");
+            return false;
+        }
+        vector<string> values;
+        if (!ParseValues(line.substr(equal_pos + 1), values)) {
+            ERROR("Cannot parse the values of " << key << ".");
+            return false;
+        }
+        keys_.push_back(key);
+        values_.push_back(values);
+    }
+    if (keys_.empty()) {
+        ERROR(filename << " does not sweep any parameter.");
+        return false;
+    }
+    return true;
+}
+
+
+/*
+ * Return the number of combinations
+ */
+size_t Sweep::size() const
+{
+    if (keys_.empty()) return 0;
+    size_t num_point = 1;
+    for (auto &values : values_) num_point *= values.size();
+    return num_point;
+}
+
+
+/*
+ * Return the values of the index-th combination
+ * The last key varies the fastest
+ */
+vector<string> Sweep::point(size_t index) const
+{
+    vector<string> values(keys_.size());
+    for (size_t k = keys_.size(); k > 0; --k) {
+        const vector<string> &choices = values_[k - 1];
+        values[k - 1] = choices[index % choices.size()];
+        index /= choices.size();
+    }
+    return values;
+}
+
+
+/*
+ * Write the records of every run, e.g. PREFIX.<run>.trc
+ */
+void Sweep::set_output(const string &prefix, bool binary)
+{
+    output_prefix_ = prefix;
+    binary_output_ = binary;
+}
+
+
+/*
+ * Simulate every combination on a pool of threads, and write one line per
+ *   combination to a CSV output
+ * Return false if any of the runs fails
+ */
+bool Sweep::run(const string &ctrl_filename,
+                const vector<string> &dev_filenames,
+                const vector<uint64_t> &sizes,
+                const vector<TraceRecord> &trace,
+                uint32_t num_jobs, ostream &csv) const
+{
+    struct Result {
+        bool success;
+        Cycle cycles;
+        double bandwidth;
+        double rd_latency;
+        double wr_latency;
+        double row_hit_rate;
+    };
+    vector<Result> results(size());
+    atomic<size_t> next_index(0);
+
+    // every thread keeps taking the next combination
+    auto work = [&]() {
+        size_t index = next_index++;
+        while (index < results.size()) {
+            vector<string> values = point(index);
+            MemorySystem membles;
+            for (size_t k = 0; k < keys_.size(); ++k) {
+                membles.set_param(keys_[k], values[k]);
+            }
+            if (fast_) membles.set_fast();
+            if (!output_prefix_.empty()) {
+                membles.set_output(output_prefix_ + "." + to_string(index),
+                                   binary_output_);
+            }
+            Result &result = results[index];
+            result.success = membles.init(ctrl_filename, dev_filenames, sizes);
+            result.cycles = 0;
+            if (result.success) {
+                MemTraceReader reader(trace);
+                Driver driver(&membles, &reader);
+                driver.set_warmup(num_warmup_);
+                if (roi_) driver.set_roi();
+                if (!checkpoint_.empty()) {
+                    result.success = driver.restore(checkpoint_);
+                }
+                if (result.success) {
+                    result.cycles = driver.run();
+                    membles.summary(driver.roi_cycle(), result.bandwidth,
+                                    result.rd_latency, result.wr_latency,
+                                    result.row_hit_rate);
+                }
+            }
+            index = next_index++;
+        }
+    };
+
+    if (num_jobs == 0) num_jobs = 1;
+    vector<thread> threads;
+    for (uint32_t j = 1; j < num_jobs; ++j) threads.push_back(thread(work));
+    work();
+    for (auto &t : threads) t.join();
+
+    // one line per combination
+    bool success = true;
+    csv << "run";
+    for (auto &key : keys_) csv << "," << key;
+    csv << ",cycles,bandwidth,read_latency,write_latency,row_hit_rate"
+        << endl;
+    for (size_t i = 0; i < results.size(); ++i) {
+        csv << i;
+        for (auto &val : point(i)) csv << "," << val;
+        const Result &result = results[i];
+        if (result.success) {
+            csv << "," << result.cycles << "," << result.bandwidth << ","
+                << result.rd_latency << "," << result.wr_latency << ","
+                << result.row_hit_rate << endl;
+        } else {
+            csv << ",N/A,N/A,N/A,N/A,N/A" << endl;
+            success = false;
+        }
+    }
+    return success;
+}
+
+
+/*
+ * Parse the values of a key, either a list separated by '|' or an integer
+ *   range lo:hi[:step]
+ */
+bool Sweep::ParseValues(const string &val_str, vector<string> &values)
+{
+    if (val_str.find(':') != string::npos &&
+            val_str.find('|') == string::npos) {
+        uint64_t range[3] = {0, 0, 1};
+        istringstream ss(val_str);
+        string field;
+        size_t num_field = 0;
+        while (getline(ss, field, ':')) {
+            if (num_field == 3) return false;
+            istringstream field_ss(field);
+            if ((field_ss >> dec >> range[num_field]).fail()) return false;
+            num_field++;
+        }
+        if (num_field < 2 || range[2] == 0 || range[0] > range[1])
+            return false;
+        // stop before val + step could wrap around
+        for (uint64_t val = range[0]; ; val += range[2]) {
+            values.push_back(to_string(val));
+            if (range[1] - val < range[2]) break;
+        }
+    } else {
+        istringstream ss(val_str);
+        string val;
+        while (getline(ss, val, '|')) {
+            if (val.empty()) return false;
+            values.push_back(val);
+        }
+    }
+    return !values.empty();
+}
+
+}
@@ -0,0 +1,104 @@
+/* Copyright (c) 2014, Jue Wang
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include <string>
+#include <vector>
+#include <ostream>
+
+#include "macro.h"
+#include "trace.h"
+
+namespace membles
+{
+
+/*
+ * A parameter sweep: every combination of the swept values is simulated by
+ *   its own memory system, and the runs share one trace loaded in memory
+ * A sweep file lists one parameter of the controller or device configuration
+ *   per line, using either a list of values or an integer range:
+ *   READ_TRANS_QUEUE=8|16|32
+ *   CMD_QUEUE=16:64:16       # from 16 to 64 (inclusive) in steps of 16
+ */
+class Sweep
+{
+
+  public:
+
+    Sweep();
+
+    bool ReadFile(const string &filename);
+
+    // number of combinations
+    size_t size() const;
+
+    // the values of a combination, in the order of keys()
+    vector<string> point(size_t index) const;
+    const vector<string> &keys() const { return keys_; }
+
+    // every run writes its records to files named PREFIX.<run>
+    void set_output(const string &prefix, bool binary);
+    // every run resumes from a checkpoint
+    void set_checkpoint(const string &filename) { checkpoint_ = filename; }
+    // every run measures the same part of the trace
+    void set_warmup(uint64_t num_tx) { num_warmup_ = num_tx; }
+    void set_roi() { roi_ = true; }
+    // every run approximates the timing, see MemorySystem::set_fast()
+    void set_fast() { fast_ = true; }
+
+    bool run(const string &ctrl_filename,
+             const vector<string> &dev_filenames,
+             const vector<uint64_t> &sizes,
+             const vector<TraceRecord> &trace,
+             uint32_t num_jobs, ostream &csv) const;
+
+  private:
+
+    vector<string> keys_;
+    vector<vector<string>> values_;
+
+    // no records are written if empty
+    string output_prefix_;
+    bool binary_output_;
+
+    // start from the beginning of the trace if empty
+    string checkpoint_;
+
+    // see Driver::set_warmup() and Driver::set_roi()
+    uint64_t num_warmup_;
+    bool roi_;
+    bool fast_;
+
+    bool ParseValues(const string &val_str, vector<string> &values);
+
+};
+
+}
+
+#endif
@@ -0,0 +1,106 @@
+/* Copyright (c) 2014, Jue Wang
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * address-map-test: decode random addresses in batches and one by one under
+ *   the stock mapping and a few others, run from the top directory
+ */
+
+#include <random>
+
+#include "../controller_config.h"
+#include "../device_config.h"
+#include "../address_map.h"
+
+using namespace membles;
+
+// the batch sizes tried, most of them leaving a tail of less than 4
+const size_t BATCHES[] = {0, 1, 3, 4, 5, 7, 8, 64, 1001};
+
+/*
+ * Decode random addresses under a mapping of a system with some channels,
+ *   as whole batches and one by one, and check that both agree
+ */
+bool compare(const string &addr_map, uint32_t num_chan)
+{
+    CtrlCfg ctrl_cfg;
+    DevCfg dev_cfg;
+    bool success = ctrl_cfg.ReadFile("ctrl/system.ctrl");
+    success &= ctrl_cfg.set("NUM_CHAN", to_string(num_chan));
+    if (!addr_map.empty()) success &= ctrl_cfg.set("ADDR_MAP", addr_map);
+    success &= dev_cfg.ReadFile("spec/LPDDR3_test.spec");
+    success &= dev_cfg.derive(1024, ctrl_cfg);
+    AddressMap mapper;
+    if (!success || !mapper.init(&ctrl_cfg, &dev_cfg)) {
+        ERROR("Cannot set up the mapping " << addr_map);
+        return false;
+    }
+
+    mt19937_64 rng(num_chan);
+    for (size_t n : BATCHES) {
+        vector<uint64_t> addrs(n);
+        for (auto &addr : addrs) addr = rng();
+        vector<uint32_t> fields[5];
+        for (auto &field : fields) field.resize(n);
+        mapper.map(addrs.data(), n, fields[0].data(), fields[1].data(),
+                   fields[2].data(), fields[3].data(), fields[4].data());
+        for (size_t i = 0; i < n; ++i) {
+            uint32_t expected[5];
+            mapper.map(addrs[i], expected[0], expected[1], expected[2],
+                       expected[3], expected[4]);
+            for (int f = 0; f < 5; ++f) {
+                if (fields[f][i] == expected[f]) continue;
+                ERROR("Mapping " << (addr_map.empty() ? "stock" : addr_map)
+                      << " of " << num_chan << " channel(s), address " << i
+                      << " of " << n << ": field " << f << " is "
+                      << fields[f][i] << " instead of " << expected[f]);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+
+int main(int argc, char *argv[])
+{
+    // the stock mapping, then one keeping every field in address bit order
+    //   and one splitting the bank bits around the column
+    const string addr_maps[] = {"", "row,bank,rank,col", "row,bank,col,bank1"};
+    bool success = true;
+    for (auto &addr_map : addr_maps) {
+        for (uint32_t num_chan = 1; num_chan <= 4; num_chan *= 2) {
+            success &= compare(addr_map, num_chan);
+        }
+    }
+    if (!success) {
+        ERROR("address-map-test failed");
+        return -1;
+    }
+    INFO("address-map-test passed");
+    return 0;
+}
@@ -0,0 +1,312 @@
+/* Copyright (c) 2014, Jue Wang
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * frontend-test: feed the memory system through the frontend from several
+ *   producer threads, run from the top directory
+ */
+
+#include <thread>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <unistd.h>
+
+#include "../memory_system.h"
+#include "../frontend.h"
+
+using namespace membles;
+
+// a hung simulation is killed after this many seconds
+const unsigned TIMEOUT = 30;
+
+// a request of a producer, the same on every run
+struct Request {
+    Cycle cycle;
+    uint64_t addr;
+    bool is_read;
+};
+
+// the arrive and finish cycles of every request, by producer and index
+typedef vector<vector<pair<Cycle, Cycle>>> TxCycles;
+
+
+/*
+ * Set up the memory system every test runs on
+ */
+bool setup(MemorySystem &membles)
+{
+    vector<string> dev_filenames(1, "spec/LPDDR3_test.spec");
+    return membles.init("ctrl/system.ctrl", dev_filenames,
+                        vector<uint64_t>(1, 1024));
+}
+
+
+/*
+ * Let every producer submit a burst of requests due at cycle 0, more than
+ *   its queue holds, and check that every one of them completes
+ */
+bool burst(uint32_t num_producer, size_t depth, uint32_t num_req)
+{
+    MemorySystem membles;
+    if (!setup(membles)) return false;
+    Frontend frontend(&membles);
+    frontend.init(num_producer, depth);
+
+    vector<uint32_t> num_done(num_producer, 0);
+    vector<thread> producers;
+    for (uint32_t i = 0; i < num_producer; ++i) {
+        producers.push_back(thread([&, i] {
+            for (uint32_t j = 0; j < num_req; ++j) {
+                uint64_t addr = ((uint64_t)j * num_producer + i) << 6;
+                while (!frontend.submit(i, 0, addr, 64, j % 2)) {
+                    this_thread::yield();
+                }
+            }
+            frontend.finish(i);
+            Frontend::Completion done;
+            while (num_done[i] < num_req) {
+                if (frontend.complete(i, done)) {
+                    num_done[i]++;
+                } else {
+                    this_thread::yield();
+                }
+            }
+        }));
+    }
+
+    while (frontend.step()) {}
+    for (auto &producer : producers) producer.join();
+
+    bool success = true;
+    for (uint32_t i = 0; i < num_producer; ++i) {
+        if (num_done[i] != num_req) {
+            ERROR("Producer " << i << " got " << num_done[i] << " of "
+                  << num_req << " completions");
+            success = false;
+        }
+    }
+    INFO(num_producer << " producer(s) of " << num_req << " requests through "
+         << depth << "-deep queues " << (success ? "passed" : "failed"));
+    return success;
+}
+
+
+/*
+ * Check that a request longer than the channel interleaving is refused up
+ *   front, and does not hold up the next one
+ */
+bool oversize()
+{
+    MemorySystem membles;
+    if (!setup(membles)) return false;
+    Frontend frontend(&membles);
+    frontend.init(1, 4);
+
+    uint32_t len = membles.max_len();
+    bool success = !frontend.submit(0, 0, 0, 2 * len, true) &&
+                   frontend.submit(0, 0, 0, membles.mal(0), true);
+    frontend.finish(0);
+    while (frontend.step()) {}
+    Frontend::Completion done;
+    success &= frontend.complete(0, done) && !frontend.complete(0, done);
+    INFO("A request longer than " << len << " bytes "
+         << (success ? "is refused" : "is not refused"));
+    return success;
+}
+
+
+/*
+ * Make up the requests of every producer, due at random cycles that never go
+ *   down, to random addresses
+ */
+vector<vector<Request>> workload(uint32_t num_producer, uint32_t num_req)
+{
+    mt19937 rng(num_producer * num_req);
+    vector<vector<Request>> work(num_producer);
+    for (auto &requests : work) {
+        Cycle cycle = 0;
+        for (uint32_t j = 0; j < num_req; ++j) {
+            cycle += rng() % 16;
+            uint64_t addr = (rng() % (1 << 24)) << 6;
+            requests.push_back(Request{cycle, addr, rng() % 3 != 0});
+        }
+    }
+    return work;
+}
+
+
+/*
+ * Submit the requests of every producer from its own thread, which yields
+ *   and sleeps at random, the jitter seeded by seed
+ * The cycles of the completions are kept in timing.
+ */
+bool replay(const vector<vector<Request>> &work, size_t depth, uint32_t seed,
+            TxCycles &timing)
+{
+    MemorySystem membles;
+    if (!setup(membles)) return false;
+    Frontend frontend(&membles);
+    uint32_t num_producer = work.size();
+    frontend.init(num_producer, depth);
+
+    timing.assign(num_producer, vector<pair<Cycle, Cycle>>());
+    vector<thread> producers;
+    for (uint32_t i = 0; i < num_producer; ++i) {
+        timing[i].resize(work[i].size());
+        producers.push_back(thread([&, i] {
+            mt19937 jitter(seed * num_producer + i);
+            auto pause = [&jitter] {
+                uint32_t r = jitter() % 8;
+                if (r == 0) {
+                    this_thread::sleep_for(chrono::microseconds(jitter() % 50));
+                } else if (r < 3) {
+                    this_thread::yield();
+                }
+            };
+            const vector<Request> &requests = work[i];
+            for (size_t j = 0; j < requests.size(); ++j) {
+                const Request &r = requests[j];
+                pause();
+                while (!frontend.submit(i, r.cycle, r.addr, 64, r.is_read,
+                                        (void *)j)) {
+                    pause();
+                }
+            }
+            frontend.finish(i);
+            Frontend::Completion done;
+            for (size_t num_done = 0; num_done < requests.size(); ) {
+                if (frontend.complete(i, done)) {
+                    timing[i][(size_t)done.data] =
+                        make_pair(done.arrive_cycle, done.finish_cycle);
+                    num_done++;
+                } else {
+                    pause();
+                }
+            }
+        }));
+    }
+
+    while (frontend.step()) {}
+    for (auto &producer : producers) producer.join();
+    return true;
+}
+
+
+/*
+ * Submit the requests of every producer from the simulation thread, as one
+ *   producer, in the order the frontend admits them: by cycle, then by
+ *   producer, then in submission order
+ */
+bool reference(const vector<vector<Request>> &work, TxCycles &timing)
+{
+    MemorySystem membles;
+    if (!setup(membles)) return false;
+    Frontend frontend(&membles);
+    vector<pair<uint32_t, size_t>> order;
+    timing.assign(work.size(), vector<pair<Cycle, Cycle>>());
+    for (uint32_t i = 0; i < work.size(); ++i) {
+        timing[i].resize(work[i].size());
+        for (size_t j = 0; j < work[i].size(); ++j) order.push_back({i, j});
+    }
+    stable_sort(order.begin(), order.end(),
+                [&work](const pair<uint32_t, size_t> &a,
+                        const pair<uint32_t, size_t> &b) {
+                    return work[a.first][a.second].cycle <
+                           work[b.first][b.second].cycle;
+                });
+    // the queues hold every request, so nothing is ever rejected
+    frontend.init(1, order.size());
+    for (size_t k = 0; k < order.size(); ++k) {
+        const Request &r = work[order[k].first][order[k].second];
+        frontend.submit(0, r.cycle, r.addr, 64, r.is_read, (void *)k);
+    }
+    frontend.finish(0);
+    while (frontend.step()) {}
+
+    Frontend::Completion done;
+    while (frontend.complete(0, done)) {
+        const pair<uint32_t, size_t> &owner = order[(size_t)done.data];
+        timing[owner.first][owner.second] =
+            make_pair(done.arrive_cycle, done.finish_cycle);
+    }
+    return true;
+}
+
+
+/*
+ * Replay the same workload several times, the producer threads interleaving
+ *   differently every time, and check that every request arrives and
+ *   finishes at the same cycles as when submitted from one thread
+ */
+bool determinism(uint32_t num_producer, size_t depth, uint32_t num_req,
+                 uint32_t num_run)
+{
+    vector<vector<Request>> work = workload(num_producer, num_req);
+    TxCycles expected;
+    if (!reference(work, expected)) return false;
+
+    bool success = true;
+    for (uint32_t run = 0; run < num_run && success; ++run) {
+        TxCycles timing;
+        if (!replay(work, depth, run, timing)) return false;
+        for (uint32_t i = 0; i < num_producer && success; ++i) {
+            for (uint32_t j = 0; j < num_req; ++j) {
+                if (timing[i][j] == expected[i][j]) continue;
+                ERROR("Run " << run << ": request " << j << " of producer "
+                      << i << " arrives at " << timing[i][j].first
+                      << " and finishes at " << timing[i][j].second
+                      << " instead of " << expected[i][j].first << " and "
+                      << expected[i][j].second);
+                success = false;
+                break;
+            }
+        }
+    }
+    INFO(num_producer << " producer(s) of " << num_req << " requests through "
+         << depth << "-deep queues, " << num_run << " runs "
+         << (success ? "matched" : "differed"));
+    return success;
+}
+
+
+int main(int argc, char *argv[])
+{
+    alarm(TIMEOUT);
+    bool success = true;
+    success &= burst(1, 4, 4);
+    success &= burst(1, 4, 10);
+    success &= burst(3, 2, 16);
+    success &= oversize();
+    success &= determinism(1, 4, 200, 3);
+    success &= determinism(4, 3, 200, 5);
+    if (!success) {
+        ERROR("frontend-test failed");
+        return -1;
+    }
+    INFO("frontend-test passed");
+    return 0;
+}
@@ -0,0 +1,133 @@
+/* Copyright (c) 2014, Jue Wang
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * membles-trace: convert traces between the text and the binary format
+ */
+
+#include <iostream>
+#include <fstream>
+#include <getopt.h>
+#include <sys/stat.h>
+
+#include "../trace.h"
+#include "../binary_trace.h"
+
+using namespace membles;
+
+void
+usage()
+{
+    cout << "membles-trace Usage: " << endl;
+    cout << "membles-trace [-b | -t] input output" << endl;
+    cout << "  -b, --binary                      write a binary trace "
+         << "(default)" << endl;
+    cout << "  -t, --text                        write a text trace" << endl;
+    cout << "  -h, --help                        print this message" << endl;
+    cout << "The input can be in either format." << endl;
+}
+
+uint64_t file_size(const string &filename)
+{
+    struct stat st;
+    if (stat(filename.c_str(), &st) != 0) return 0;
+    return st.st_size;
+}
+
+int main(int argc, char *argv[])
+{
+    bool to_binary = true;
+
+    //getopt stuff
+    while (1) {
+        static struct option long_opts[] = {
+            {"binary", no_argument, 0, 'b'},
+            {"text", no_argument, 0, 't'},
+            {"help", no_argument, 0, 'h'},
+            {0, 0, 0, 0}
+        };
+        int opt_index = 0; //for getopt
+        int c = getopt_long(argc, argv, "bth", long_opts, &opt_index);
+        if (c == -1) break;
+        switch (c) {
+        case 'h':
+            usage();
+            exit(0);
+            break;
+        case 'b':
+            to_binary = true;
+            break;
+        case 't':
+            to_binary = false;
+            break;
+        default:
+            usage();
+            exit(-1);
+        }
+    }
+
+    if (argc - optind != 2) {
+        usage();
+        exit(-1);
+    }
+    string in_filename(argv[optind]);
+    string out_filename(argv[optind + 1]);
+
+    TraceReader *reader = OpenTrace(in_filename);
+    if (!reader) exit(-1);
+
+    uint64_t num_record = 0;
+    TraceRecord record;
+    bool success = true;
+    if (to_binary) {
+        BinaryTraceWriter writer;
+        success = writer.open(out_filename);
+        while (success && reader->next(record)) {
+            writer.write(record);
+            num_record++;
+        }
+        success &= writer.close();
+    } else {
+        ofstream file(out_filename.c_str());
+        success = file.is_open();
+        while (success && reader->next(record)) {
+            WriteTraceLine(file, record);
+            num_record++;
+        }
+        success &= file.good();
+    }
+    delete reader;
+
+    if (!success) {
+        ERROR("Fail to write " << out_filename << ".");
+        exit(-1);
+    }
+    uint64_t in_size = file_size(in_filename);
+    uint64_t out_size = file_size(out_filename);
+    INFO(num_record << " records, " << in_size << " -> " << out_size
+         << " bytes");
+}
@@ -0,0 +1,455 @@
+/* Copyright (c) 2014, Jue Wang
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <cstdint>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "trace.h"
+#include "binary_trace.h"
+#include "gzip_trace.h"
+
+namespace membles
+{
+
+/*
+ * Helpers of the trace parser, which works on the bytes of a line in place
+ */
+static inline bool IsBlank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline const char *SkipBlank(const char *pos, const char *end)
+{
+    while (pos < end && IsBlank(*pos)) ++pos;
+    return pos;
+}
+
+// a number has to be followed by a blank or the end of the line
+static inline bool ParseDec(const char *&pos, const char *end, uint64_t &val)
+{
+    const char *start = pos;
+    uint64_t result = 0;
+    while (pos < end) {
+        uint32_t digit = (uint8_t)*pos - '0';
+        if (digit > 9) break;
+        result = result * 10 + digit;
+        ++pos;
+    }
+    val = result;
+    return pos != start && (pos == end || IsBlank(*pos));
+}
+
+static inline bool ParseHex(const char *&pos, const char *end, uint64_t &val)
+{
+    const char *start = pos;
+    uint64_t result = 0;
+    while (pos < end) {
+        uint8_t c = *pos;
+        uint32_t digit = c - '0';
+        if (digit > 9) {
+            // fold to lower case, then 'a'..'f' map to 10..15
+            digit = (uint8_t)((c | 0x20) - 'a');
+            if (digit > 5) break;
+            digit += 10;
+        }
+        result = (result << 4) | digit;
+        ++pos;
+    }
+    val = result;
+    return pos != start && (pos == end || IsBlank(*pos));
+}
+
+
+// a keyword has to be followed by a blank or the end of the line
+static inline bool ParseWord(const char *&pos, const char *end,
+                             const char *word)
+{
+    size_t len = strlen(word);
+    if ((size_t)(end - pos) < len || memcmp(pos, word, len) != 0 ||
+            (pos + len < end && !IsBlank(pos[len]))) {
+        return false;
+    }
+    pos += len;
+    return true;
+}
+
+
+/*
+ * Parse one line of a text trace, without the line break
+ * Return false if the line carries neither a transaction nor a marker, and
+ *   warn if it is neither blank nor a comment
+ */
+bool ParseTraceLine(const char *begin, const char *end, TraceRecord &record)
+{
+    const char *pos = SkipBlank(begin, end);
+    // skip empty lines
+    if (pos == end) return false;
+    // comment lines, some of which are markers
+    if (*pos == '#') {
+        pos = SkipBlank(pos + 1, end);
+        if (ParseWord(pos, end, "ROI_BEGIN")) {
+            record.marker = ROI_BEGIN;
+        } else if (ParseWord(pos, end, "ROI_END")) {
+            record.marker = ROI_END;
+        } else {
+            return false;
+        }
+        record.time = 0;
+        record.addr = 0;
+        record.len = 0;
+        record.is_read = false;
+        record.priority = 0;
+        return true;
+    }
+
+    uint64_t val = 0;
+    const char *what = nullptr;
+    do {
+        // get timestamp
+        what = "timestamp";
+        if (!ParseDec(pos, end, record.time)) break;
+        pos = SkipBlank(pos, end);
+        // get read/write
+        what = "R/W field";
+        if (pos == end) break;
+        char rw = *pos | 0x20;
+        if (rw != 'r' && rw != 'w') break;
+        record.is_read = (rw == 'r');
+        ++pos;
+        if (pos < end && !IsBlank(*pos)) break;
+        pos = SkipBlank(pos, end);
+        // get starting address, which should be a hex
+        what = "starting address";
+        if (end - pos < 2 || pos[0] != '0' || (pos[1] | 0x20) != 'x') break;
+        pos += 2;
+        if (!ParseHex(pos, end, record.addr)) break;
+        pos = SkipBlank(pos, end);
+        // get transaction size
+        what = "transaction size";
+        if (!ParseDec(pos, end, val) || val > UINT32_MAX) break;
+        record.len = val;
+        pos = SkipBlank(pos, end);
+        // get priority level
+        what = "priority level";
+        if (!ParseDec(pos, end, val) || val > UINT16_MAX) break;
+        record.priority = val;
+        record.marker = NO_MARKER;
+
+        // TODO: handle data
+
+        // success
+        return true;
+    } while (false);
+
+    WARN("Fail to parse " << what << " in trace line \'"
+         << string(begin, end) << "\'");
+    return false;
+}
+
+
+/*
+ * Print a record in the text trace syntax
+ */
+void WriteTraceLine(ostream &os, const TraceRecord &record)
+{
+    if (record.marker == ROI_BEGIN) {
+        os << "# ROI_BEGIN\n";
+        return;
+    } else if (record.marker == ROI_END) {
+        os << "# ROI_END\n";
+        return;
+    }
+    os << dec << record.time << (record.is_read ? " R 0x" : " W 0x")
+       << hex << uppercase << record.addr << dec << nouppercase << " "
+       << record.len << " " << record.priority << "\n";
+}
+
+
+/*
+ * Open a text trace file
+ */
+bool TextTraceReader::open(const string &filename)
+{
+    file_.open(filename.c_str());
+    if (!file_.is_open()) {
+        ERROR("Could not open trace file <" << filename << ">.");
+        return false;
+    }
+    return true;
+}
+
+
+/*
+ * Read lines until one of them carries a transaction
+ */
+bool TextTraceReader::next(TraceRecord &record)
+{
+    string line;
+    while (getline(file_, line)) {
+        const char *begin = line.data();
+        if (ParseTraceLine(begin, begin + line.size(), record)) return true;
+    }
+    return false;
+}
+
+
+/*
+ * Read and drop records, which works for every reader
+ */
+uint64_t TraceReader::skip(uint64_t count)
+{
+    TraceRecord record;
+    uint64_t skipped = 0;
+    while (skipped < count && next(record)) skipped++;
+    return skipped;
+}
+
+
+/* ctor: Memory Trace Reader
+ * Start from the first record
+ */
+MemTraceReader::MemTraceReader(const vector<TraceRecord> &records)
+    : records_(records),
+      pos_(0)
+{}
+
+
+/*
+ * Hand out the next record
+ */
+bool MemTraceReader::next(TraceRecord &record)
+{
+    if (pos_ == records_.size()) return false;
+    record = records_[pos_++];
+    return true;
+}
+
+
+/*
+ * Move the position forward
+ */
+uint64_t MemTraceReader::skip(uint64_t count)
+{
+    count = min(count, (uint64_t)(records_.size() - pos_));
+    pos_ += count;
+    return count;
+}
+
+
+
+/* ctor: Mmap Trace Reader
+ * Nothing is mapped until open() is called
+ */
+MmapTraceReader::MmapTraceReader()
+    : data_(nullptr),
+      size_(0),
+      pos_(nullptr)
+{}
+
+
+/* dtor: Mmap Trace Reader
+ * Unmap the file
+ */
+MmapTraceReader::~MmapTraceReader()
+{
+    if (data_) munmap((void *)data_, size_);
+}
+
+
+/*
+ * Map a text trace file into memory
+ * Return false if the file cannot be mapped, e.g. it is a pipe
+ */
+bool MmapTraceReader::open(const string &filename)
+{
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return false;
+    }
+    size_ = st.st_size;
+    if (size_ > 0) {
+        void *addr = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) {
+            close(fd);
+            return false;
+        }
+        data_ = (const char *)addr;
+        // the trace is read once from the beginning to the end
+        madvise(addr, size_, MADV_SEQUENTIAL);
+    }
+    // the mapping stays valid after the file is closed
+    close(fd);
+    pos_ = data_;
+    return true;
+}
+
+
+/*
+ * Parse lines until one of them carries a transaction
+ */
+bool MmapTraceReader::next(TraceRecord &record)
+{
+    const char *end = data_ + size_;
+    while (pos_ < end) {
+        const char *line = pos_;
+        const char *eol = (const char *)memchr(line, '\n', end - line);
+        if (!eol) eol = end;
+        pos_ = (eol == end) ? end : eol + 1;
+        if (ParseTraceLine(line, eol, record)) return true;
+    }
+    return false;
+}
+
+
+/* ctor: Prefetch Trace Reader
+ * The thread is not started until the first record is asked for
+ */
+PrefetchTraceReader::PrefetchTraceReader(TraceReader *source, size_t depth)
+    : source_(source),
+      done_(false),
+      stopping_(false)
+{
+    records_.init(depth);
+}
+
+
+/* dtor: Prefetch Trace Reader
+ * Stop the thread and delete the source reader
+ */
+PrefetchTraceReader::~PrefetchTraceReader()
+{
+    if (thread_.joinable()) {
+        stopping_.store(true, memory_order_release);
+        thread_.join();
+    }
+    delete source_;
+}
+
+
+/*
+ * Take the next record, waiting for the thread if it falls behind
+ */
+bool PrefetchTraceReader::next(TraceRecord &record)
+{
+    if (!thread_.joinable()) thread_ = thread(&PrefetchTraceReader::run, this);
+    while (!records_.pop(record)) {
+        // the thread sets done_ after its last push, so check the queue once
+        //   more after seeing it
+        if (done_.load(memory_order_acquire)) return records_.pop(record);
+        this_thread::yield();
+    }
+    return true;
+}
+
+
+/*
+ * Let the source skip records if the thread has not started yet
+ */
+uint64_t PrefetchTraceReader::skip(uint64_t count)
+{
+    if (!thread_.joinable()) return source_->skip(count);
+    return TraceReader::skip(count);
+}
+
+
+/*
+ * Thread body: keep the queue filled until the source runs out
+ */
+void PrefetchTraceReader::run()
+{
+    TraceRecord record;
+    while (source_->next(record)) {
+        while (!records_.push(record)) {
+            if (stopping_.load(memory_order_acquire)) return;
+            this_thread::yield();
+        }
+        if (stopping_.load(memory_order_relaxed)) return;
+    }
+    done_.store(true, memory_order_release);
+}
+
+
+/*
+ * Open a trace with the fastest reader that works for the file
+ * A binary trace is told apart from a text trace by its magic
+ * With prefetch, the file is read ahead on a thread of its own, which is
+ *   always the case for a gzip-compressed trace since inflating costs more
+ *   than the simulation
+ * Return nullptr if the file cannot be opened
+ */
+TraceReader *OpenTrace(const string &filename, bool prefetch)
+{
+    TraceReader *reader = nullptr;
+    if (IsGzipTrace(filename)) {
+        GzipTraceReader *gz_reader = new GzipTraceReader;
+        if (!gz_reader->open(filename)) {
+            delete gz_reader;
+            return nullptr;
+        }
+        return new PrefetchTraceReader(gz_reader);
+    }
+    if (IsBinaryTrace(filename)) {
+        BinaryTraceReader *bin_reader = new BinaryTraceReader;
+        if (bin_reader->open(filename)) {
+            reader = bin_reader;
+        } else {
+            delete bin_reader;
+            return nullptr;
+        }
+    }
+    if (!reader) {
+        MmapTraceReader *mmap_reader = new MmapTraceReader;
+        if (mmap_reader->open(filename)) {
+            reader = mmap_reader;
+        } else {
+            delete mmap_reader;
+        }
+    }
+    if (!reader) {
+        // fall back to a stream, which also works for pipes
+        TextTraceReader *text_reader = new TextTraceReader;
+        if (text_reader->open(filename)) {
+            reader = text_reader;
+        } else {
+            delete text_reader;
+            return nullptr;
+        }
+    }
+    if (prefetch) reader = new PrefetchTraceReader(reader);
+    return reader;
+}
+
+}
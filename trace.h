@@ -0,0 +1,212 @@
+/* Copyright (c) 2014, Jue Wang
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <atomic>
+#include <thread>
+
+#include "macro.h"
+#include "spsc_queue.h"
+
+namespace membles
+{
+
+/*
+ * Markers a trace carries between its transactions
+ */
+enum TraceMarker : uint8_t {
+    NO_MARKER,
+    ROI_BEGIN,      // region of interest
+    ROI_END
+};
+
+
+/*
+ * One transaction of a trace, or a marker
+ */
+struct TraceRecord {
+    // arrival time, unit: picosecond
+    uint64_t time;
+    uint64_t addr;
+    uint32_t len;
+    bool is_read;
+    // priority level, 0=lowest
+    uint16_t priority;
+    // the rest of the fields are meaningless if this is a marker
+    TraceMarker marker;
+};
+
+
+bool ParseTraceLine(const char *begin, const char *end, TraceRecord &record);
+void WriteTraceLine(ostream &os, const TraceRecord &record);
+
+
+/*
+ * A source of trace records
+ */
+class TraceReader
+{
+
+  public:
+
+    virtual ~TraceReader() {}
+
+    // get the next record, return false at the end of the trace
+    virtual bool next(TraceRecord &record) = 0;
+
+    // jump over records, return the number of records actually skipped
+    virtual uint64_t skip(uint64_t count);
+
+};
+
+
+/*
+ * Read a text trace, one transaction per line:
+ *   <time in ps> <R|W> <0x address> <length> <priority>
+ * or a marker line, "# ROI_BEGIN" or "# ROI_END"
+ * Empty lines, other comment lines (starting with '#') and malformed lines
+ *   are skipped
+ */
+class TextTraceReader : public TraceReader
+{
+
+  public:
+
+    bool open(const string &filename);
+
+    bool next(TraceRecord &record);
+
+  private:
+
+    ifstream file_;
+
+};
+
+
+/*
+ * Read a text trace mapped into memory, which is parsed in place
+ * It accepts the same syntax as TextTraceReader, but never copies a line
+ */
+class MmapTraceReader : public TraceReader
+{
+
+  public:
+
+    MmapTraceReader();
+    ~MmapTraceReader();
+
+    bool open(const string &filename);
+
+    bool next(TraceRecord &record);
+
+  private:
+
+    // the mapped file
+    const char *data_;
+    size_t size_;
+
+    // the first byte not parsed yet
+    const char *pos_;
+
+    // a mapping must not be shared
+    MmapTraceReader(const MmapTraceReader &);
+    MmapTraceReader &operator=(const MmapTraceReader &);
+
+};
+
+
+/*
+ * Replay records that are already in memory
+ * The records are not copied, so they can be shared by many readers
+ */
+class MemTraceReader : public TraceReader
+{
+
+  public:
+
+    MemTraceReader(const vector<TraceRecord> &records);
+
+    bool next(TraceRecord &record);
+    uint64_t skip(uint64_t count);
+
+  private:
+
+    const vector<TraceRecord> &records_;
+    size_t pos_;
+
+};
+
+
+/*
+ * Read a trace ahead of the simulator on a thread of its own
+ * The thread pulls records from another reader and parks them in a bounded
+ *   lock-free queue, so file I/O and parsing overlap with the simulation.
+ *   Transactions are still allocated by the simulator, since the memory
+ *   system recycles them through a single-threaded pool.
+ * The thread starts with the first record asked for, so the source can still
+ *   skip records on its own before that.
+ */
+class PrefetchTraceReader : public TraceReader
+{
+
+  public:
+
+    // take over a reader, which is deleted along with this one
+    PrefetchTraceReader(TraceReader *source, size_t depth = 65536);
+    ~PrefetchTraceReader();
+
+    bool next(TraceRecord &record);
+    uint64_t skip(uint64_t count);
+
+  private:
+
+    TraceReader *source_;
+
+    SpscQueue<TraceRecord> records_;
+
+    // set by the thread once the source runs out
+    atomic<bool> done_;
+    // set when the reader is destroyed before the source runs out
+    atomic<bool> stopping_;
+
+    thread thread_;
+
+    void run();
+
+};
+
+
+TraceReader *OpenTrace(const string &filename, bool prefetch = false);
+
+}
+
+#endif
@@ -29,22 +29,30 @@
 namespace membles
 {
 
-uint64_t Transaction::count = 0;
-
 /* ctor: Transaction
- * Set the transaction ID and increment the transaction count
+ * Set the transaction ID, which is given by the memory system
  * The default priority level is always 0, the lowest level
  */
-Transaction::Transaction(uint64_t addr,
+Transaction::Transaction(uint64_t id,
+                         uint64_t addr,
                          uint32_t len,
                          bool is_read,
                          void *data)
-    : id_(count++),
+    : id_(id),
       addr_(addr),
       len_(len),
       is_read_(is_read),
       priority_(0),
-      data_(data)
+      sample_(NO_SAMPLE),
+      data_(data),
+      chan_(0),
+      rank_(0),
+      bank_(0),
+      row_(0),
+      col_(0),
+      slot_(0),
+      arrive_cycle_(0),
+      finish_cycle_(0)
 {}
 
 }
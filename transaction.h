@@ -27,17 +27,23 @@
 #ifndef TRANSACTION_H
 #define TRANSACTION_H
 
-#include <cstdint>
+#include <functional>
+
+#include "macro.h"
 
 namespace membles
 {
 
+// the sample index of a transaction that is not sampled
+const uint32_t NO_SAMPLE = UINT32_MAX;
+
 class Transaction
 {
 
   public:
 
-    Transaction(uint64_t addr,
+    Transaction(uint64_t id,
+                uint64_t addr,
                 uint32_t len,
                 bool is_read,
                 void *data = nullptr);
@@ -48,6 +54,38 @@ class Transaction
     uint32_t len() const { return len_; }
     uint16_t priority() const { return priority_; }
     void set_priority(uint16_t priority) { priority_ = priority; }
+    // data given by the caller, passed back untouched on completion
+    void *data() const { return data_; }
+    // whether the channel follows the transaction for the latency breakdown,
+    //   and where it keeps the timestamps
+    bool sampled() const { return sample_ != NO_SAMPLE; }
+    uint32_t sample() const { return sample_; }
+    void set_sample(uint32_t sample) { sample_ = sample; }
+
+    // DRAM coordinates, valid once the transaction is accepted by a channel
+    uint32_t chan() const { return chan_; }
+    uint32_t rank() const { return rank_; }
+    uint32_t bank() const { return bank_; }
+    uint32_t row() const { return row_; }
+    uint32_t col() const { return col_; }
+    // position in the response queue of its channel
+    uint32_t slot() const { return slot_; }
+    void set_slot(uint32_t slot) { slot_ = slot; }
+    // cycle the transaction is accepted by a channel
+    Cycle arrive_cycle() const { return arrive_cycle_; }
+    void set_arrive_cycle(Cycle cycle) { arrive_cycle_ = cycle; }
+    // cycle the transaction is retired, valid once it is retired
+    Cycle finish_cycle() const { return finish_cycle_; }
+    void set_finish_cycle(Cycle cycle) { finish_cycle_ = cycle; }
+
+    void set_coord(uint32_t chan, uint32_t rank, uint32_t bank, uint32_t row,
+                   uint32_t col) {
+        chan_ = chan;
+        rank_ = rank;
+        bank_ = bank;
+        row_ = row;
+        col_ = col;
+    }
 
   protected:
 
@@ -61,15 +99,29 @@ class Transaction
     bool is_read_;
     // transaction priority level, 0=lowest
     uint16_t priority_;
+    // index of the sampled lifecycle in its channel
+    uint32_t sample_;
     // transaction data, optional
     void *data_;
-
-  private:
-  
-    static uint64_t count;
+    // decoded DRAM coordinates
+    uint32_t chan_;
+    uint32_t rank_;
+    uint32_t bank_;
+    uint32_t row_;
+    uint32_t col_;
+    // response queue slot
+    uint32_t slot_;
+    // arrival cycle
+    Cycle arrive_cycle_;
+    // retirement cycle
+    Cycle finish_cycle_;
 
 };
 
+// called with a retired transaction, which is given back to the memory system
+//   right afterwards
+typedef function<void(const Transaction &tx)> TxCallback;
+
 }
 
 #endif